@@ -1,25 +1,79 @@
 """ZW101 指纹识别模组组件"""
 import esphome.codegen as cg
 import esphome.config_validation as cv
+from esphome import pins
 from esphome.components import uart
-from esphome.const import CONF_ID
+from esphome.const import CONF_ADDRESS, CONF_ID
 
 DEPENDENCIES = ["uart"]
 AUTO_LOAD = ["binary_sensor", "sensor", "text_sensor", "switch"]
+# 允许多个实例, 例如进门、出门两个读头各接一个串口, 传感器通过 zw101_id 区分
+MULTI_CONF = True
 
 # 定义命名空间
 zw101_ns = cg.esphome_ns.namespace("zw101")
 ZW101Component = zw101_ns.class_("ZW101Component", cg.Component, uart.UARTDevice)
 
+CONF_TOUCH_PIN = "touch_pin"
+CONF_TARGET_BAUD_RATE = "target_baud_rate"
+CONF_MIN_POLL_INTERVAL = "min_poll_interval"
+CONF_MAX_POLL_INTERVAL = "max_poll_interval"
+CONF_TRACE_BUFFER_SIZE = "trace_buffer_size"
+CONF_DUMP_TRACE_ON_ERROR = "dump_trace_on_error"
+CONF_SLEEP_TIMEOUT = "sleep_timeout"
+CONF_CANDIDATE_MATCH = "candidate_match"
+CONF_OPTIMIZE_LIBRARY = "optimize_library"
+
+
+def validate_poll_interval(config):
+    """最短轮询间隔不能大于最长轮询间隔"""
+    if config[CONF_MIN_POLL_INTERVAL] > config[CONF_MAX_POLL_INTERVAL]:
+        raise cv.Invalid(f"{CONF_MIN_POLL_INTERVAL} must not exceed {CONF_MAX_POLL_INTERVAL}")
+    return config
+
+
+def validate_sleep_timeout(config):
+    """休眠后只能由手指触摸唤醒, 自动休眠需要触摸引脚"""
+    if CONF_SLEEP_TIMEOUT in config and CONF_TOUCH_PIN not in config:
+        raise cv.Invalid(f"{CONF_SLEEP_TIMEOUT} requires {CONF_TOUCH_PIN}")
+    return config
+
+
 # 配置模式
-CONFIG_SCHEMA = (
+CONFIG_SCHEMA = cv.All(
     cv.Schema(
         {
             cv.GenerateID(): cv.declare_id(ZW101Component),
+            # 模组 TOUCH_OUT 引脚 (手指按下为高), 配置后由中断唤醒搜索
+            cv.Optional(CONF_TOUCH_PIN): pins.internal_gpio_input_pin_schema,
+            # 启动时把模组切换到该波特率 (写系统寄存器4, N x 9600, 最高 115200)
+            cv.Optional(CONF_TARGET_BAUD_RATE): cv.one_of(
+                19200, 38400, 57600, 115200, int=True
+            ),
+            # 自适应轮询间隔: 有活动后按最短间隔轮询, 安静后逐步放慢到最长间隔
+            cv.Optional(
+                CONF_MIN_POLL_INTERVAL, default="150ms"
+            ): cv.positive_time_period_milliseconds,
+            cv.Optional(
+                CONF_MAX_POLL_INTERVAL, default="600ms"
+            ): cv.positive_time_period_milliseconds,
+            # 串口收发跟踪缓冲区字节数, 0 为关闭; 指令超时或校验错误时可自动输出到日志
+            cv.Optional(CONF_TRACE_BUFFER_SIZE, default=0): cv.int_range(min=0, max=65536),
+            cv.Optional(CONF_DUMP_TRACE_ON_ERROR, default=False): cv.boolean,
+            # 模组地址, 出厂为 0xFFFFFFFF; 多个模组经收发器共用一个 UART 时各用不同地址
+            cv.Optional(CONF_ADDRESS, default=0xFFFFFFFF): cv.hex_uint32_t,
+            # 搜索前先与最常匹配的几页做 1:1 比对, 0 为关闭; 指纹库大、常用用户少时缩短解锁时间
+            cv.Optional(CONF_CANDIDATE_MATCH, default=0): cv.int_range(min=0, max=8),
+            # 空闲时把常用用户的模板搬到靠前的页, 缩短 1:N 搜索; match_id 等对外的 ID 保持不变
+            cv.Optional(CONF_OPTIMIZE_LIBRARY, default=False): cv.boolean,
+            # 空闲多久后让模组休眠; 按下手指时先唤醒模组, 解锁延迟增加一次唤醒的时间
+            cv.Optional(CONF_SLEEP_TIMEOUT): cv.positive_time_period_milliseconds,
         }
     )
     .extend(cv.COMPONENT_SCHEMA)
-    .extend(uart.UART_DEVICE_SCHEMA)
+    .extend(uart.UART_DEVICE_SCHEMA),
+    validate_poll_interval,
+    validate_sleep_timeout,
 )
 
 
@@ -28,3 +82,36 @@ async def to_code(config):
     var = cg.new_Pvariable(config[CONF_ID])
     await cg.register_component(var, config)
     await uart.register_uart_device(var, config)
+
+    cg.add(
+        var.set_poll_interval_bounds(
+            config[CONF_MIN_POLL_INTERVAL].total_milliseconds,
+            config[CONF_MAX_POLL_INTERVAL].total_milliseconds,
+        )
+    )
+
+    if config[CONF_TRACE_BUFFER_SIZE] > 0:
+        cg.add(var.set_trace_buffer_size(config[CONF_TRACE_BUFFER_SIZE]))
+    if config[CONF_DUMP_TRACE_ON_ERROR]:
+        cg.add(var.set_dump_trace_on_error(True))
+
+    if config[CONF_ADDRESS] != 0xFFFFFFFF:
+        cg.add(var.set_address(config[CONF_ADDRESS]))
+
+    if config[CONF_CANDIDATE_MATCH] > 0:
+        cg.add(var.set_candidate_count(config[CONF_CANDIDATE_MATCH]))
+
+    # 关闭重排后仍要读回已有的 ID 映射, 键总是按组件 ID 生成
+    cg.add(var.set_preference_key(config[CONF_ID].id))
+    if config[CONF_OPTIMIZE_LIBRARY]:
+        cg.add(var.set_optimize_library(True))
+
+    if CONF_TARGET_BAUD_RATE in config:
+        cg.add(var.set_target_baud_rate(config[CONF_TARGET_BAUD_RATE]))
+
+    if CONF_TOUCH_PIN in config:
+        pin = await cg.gpio_pin_expression(config[CONF_TOUCH_PIN])
+        cg.add(var.set_touch_pin(pin))
+
+    if CONF_SLEEP_TIMEOUT in config:
+        cg.add(var.set_sleep_timeout(config[CONF_SLEEP_TIMEOUT].total_milliseconds))
@@ -4,8 +4,13 @@ import esphome.config_validation as cv
 from esphome.components import sensor
 from esphome.const import (
     CONF_ID,
+    ENTITY_CATEGORY_DIAGNOSTIC,
     ICON_FINGERPRINT,
     STATE_CLASS_MEASUREMENT,
+    STATE_CLASS_TOTAL_INCREASING,
+    UNIT_MILLISECOND,
+    UNIT_PERCENT,
+    UNIT_SECOND,
 )
 
 from . import ZW101Component, zw101_ns
@@ -15,6 +20,52 @@ DEPENDENCIES = ["zw101"]
 CONF_ZW101_ID = "zw101_id"
 CONF_MATCH_SCORE = "match_score"
 CONF_MATCH_ID = "match_id"
+CONF_POLL_INTERVAL = "poll_interval"
+CONF_SEARCH_PAGES = "search_pages"
+CONF_WAKE_LATENCY = "wake_latency"
+CONF_SLEEP_TIME = "sleep_time"
+CONF_CANDIDATE_HIT_RATE = "candidate_hit_rate"
+CONF_COMMAND_LATENCY = "command_latency"
+CONF_COMMAND = "command"
+CONF_STATISTIC = "statistic"
+
+LatencyStatistic = zw101_ns.enum("LatencyStatistic")
+STATISTICS = {
+    "min": LatencyStatistic.LATENCY_MIN,
+    "avg": LatencyStatistic.LATENCY_AVG,
+    "p95": LatencyStatistic.LATENCY_P95,
+    "max": LatencyStatistic.LATENCY_MAX,
+}
+
+# 常用指令别名, 也可以直接填写指令码 (如 0x04)
+COMMANDS = {
+    "get_image": 0x01,
+    "gen_char": 0x02,
+    "match": 0x03,
+    "search": 0x04,
+    "reg_model": 0x05,
+    "store": 0x06,
+    "load_char": 0x07,
+    "up_char": 0x08,
+    "down_char": 0x09,
+    "delete": 0x0C,
+    "clear": 0x0D,
+    "read_index_table": 0x1F,
+    "get_image_enroll": 0x29,
+    "auto_enroll": 0x31,
+    "auto_match": 0x32,
+    "sleep": 0x33,
+    "handshake": 0x35,
+    "rgb": 0x3C,
+}
+
+
+def validate_command(value):
+    """指令别名或指令码"""
+    if isinstance(value, str) and value.lower() in COMMANDS:
+        return COMMANDS[value.lower()]
+    return cv.hex_uint8_t(value)
+
 
 CONFIG_SCHEMA = cv.Schema(
     {
@@ -29,6 +80,60 @@ CONFIG_SCHEMA = cv.Schema(
             accuracy_decimals=0,
             state_class=STATE_CLASS_MEASUREMENT,
         ),
+        cv.Optional(CONF_POLL_INTERVAL): sensor.sensor_schema(
+            unit_of_measurement=UNIT_MILLISECOND,
+            icon="mdi:timer-outline",
+            accuracy_decimals=0,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        cv.Optional(CONF_SEARCH_PAGES): sensor.sensor_schema(
+            icon="mdi:book-search-outline",
+            accuracy_decimals=0,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        # 休眠后按下手指到模组应答握手的时间, 每次唤醒发布
+        cv.Optional(CONF_WAKE_LATENCY): sensor.sensor_schema(
+            unit_of_measurement=UNIT_MILLISECOND,
+            icon="mdi:sleep-off",
+            accuracy_decimals=0,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        # 模组累计休眠时间, 每次唤醒发布
+        cv.Optional(CONF_SLEEP_TIME): sensor.sensor_schema(
+            unit_of_measurement=UNIT_SECOND,
+            icon="mdi:sleep",
+            accuracy_decimals=0,
+            state_class=STATE_CLASS_TOTAL_INCREASING,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        # 候选 1:1 比对命中的比例 (需要 candidate_match), 每次比对后发布
+        cv.Optional(CONF_CANDIDATE_HIT_RATE): sensor.sensor_schema(
+            unit_of_measurement=UNIT_PERCENT,
+            icon="mdi:bullseye-arrow",
+            accuracy_decimals=1,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        # 指令往返延迟 (毫秒), 每分钟发布一次
+        cv.Optional(CONF_COMMAND_LATENCY): cv.ensure_list(
+            sensor.sensor_schema(
+                unit_of_measurement=UNIT_MILLISECOND,
+                icon="mdi:timer-sand",
+                accuracy_decimals=1,
+                state_class=STATE_CLASS_MEASUREMENT,
+                entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+            ).extend(
+                {
+                    cv.Required(CONF_COMMAND): validate_command,
+                    cv.Optional(CONF_STATISTIC, default="avg"): cv.enum(
+                        STATISTICS, lower=True
+                    ),
+                }
+            )
+        ),
     }
 )
 
@@ -44,3 +149,29 @@ async def to_code(config):
     if CONF_MATCH_ID in config:
         sens = await sensor.new_sensor(config[CONF_MATCH_ID])
         cg.add(parent.set_match_id_sensor(sens))
+
+    if CONF_POLL_INTERVAL in config:
+        sens = await sensor.new_sensor(config[CONF_POLL_INTERVAL])
+        cg.add(parent.set_poll_interval_sensor(sens))
+
+    if CONF_SEARCH_PAGES in config:
+        sens = await sensor.new_sensor(config[CONF_SEARCH_PAGES])
+        cg.add(parent.set_search_pages_sensor(sens))
+
+    if CONF_WAKE_LATENCY in config:
+        sens = await sensor.new_sensor(config[CONF_WAKE_LATENCY])
+        cg.add(parent.set_wake_latency_sensor(sens))
+
+    if CONF_SLEEP_TIME in config:
+        sens = await sensor.new_sensor(config[CONF_SLEEP_TIME])
+        cg.add(parent.set_sleep_time_sensor(sens))
+
+    if CONF_CANDIDATE_HIT_RATE in config:
+        sens = await sensor.new_sensor(config[CONF_CANDIDATE_HIT_RATE])
+        cg.add(parent.set_candidate_hit_rate_sensor(sens))
+
+    for conf in config.get(CONF_COMMAND_LATENCY, []):
+        sens = await sensor.new_sensor(conf)
+        cg.add(
+            parent.add_latency_sensor(conf[CONF_COMMAND], conf[CONF_STATISTIC], sens)
+        )
@@ -1,34 +1,133 @@
 #include "zw101.h"
 #include "esphome/core/log.h"
 
+#include <algorithm>
+#include <cstring>
+
 namespace esphome {
 namespace zw101 {
 
 static const char *const TAG = "zw101";
 
+using C = ZW101Component;
+
+// 固定指令帧 (编译期生成, 常量存放在 flash, 对应 fp_syno_protocol.c 的 syno_fixed_cmd_*)
+static constexpr auto FRAME_GET_IMAGE = make_command_frame<C::CMD_GET_IMAGE>();
+static constexpr auto FRAME_GET_IMAGE_ENROLL = make_command_frame<C::CMD_GET_IMAGE_ENROLL>();
+static constexpr auto FRAME_REG_MODEL = make_command_frame<C::CMD_REG_MODEL>();
+static constexpr auto FRAME_CLEAR_LIB = make_command_frame<C::CMD_CLEAR_LIB>();
+static constexpr auto FRAME_READ_SYSPARA = make_command_frame<C::CMD_READ_SYSPARA>();
+static constexpr auto FRAME_READ_VALID_NUMS = make_command_frame<C::CMD_READ_VALID_NUMS>();
+static constexpr auto FRAME_INTO_SLEEP = make_command_frame<C::CMD_INTO_SLEEP>();
+static constexpr auto FRAME_HANDSHAKE = make_command_frame<C::CMD_HANDSHAKE>();
+static constexpr auto FRAME_AUTO_CANCEL = make_command_frame<C::CMD_AUTO_CANCEL>();
+static constexpr auto FRAME_CHECK_FINGER = make_command_frame<C::CMD_CHECK_FINGER>();
+
+// 参数化指令模板: 可变字段先填0, 发送时复制一份只改写可变字段
+static constexpr auto FRAME_GEN_CHAR = make_command_frame<C::CMD_GEN_CHAR, 0x00>();  // BufferID
+static constexpr auto FRAME_READ_INDEX_TABLE = make_command_frame<C::CMD_READ_INDEX_TABLE, 0x00>();  // 索引表页
+static constexpr auto FRAME_WRITE_REG = make_command_frame<C::CMD_WRITE_SYSPARA, 0x00, 0x00>();  // 寄存器号, 内容
+static constexpr auto FRAME_SEARCH =
+    make_command_frame<C::CMD_SEARCH, 0x00, 0x00, 0x00, 0x00, 0x00>();  // BufferID, StartPage, PageNum
+static constexpr auto FRAME_STORE_CHAR = make_command_frame<C::CMD_STORE_CHAR, 0x00, 0x00, 0x00>();  // BufferID, PageID
+static constexpr auto FRAME_LOAD_CHAR = make_command_frame<C::CMD_LOAD_CHAR, 0x00, 0x00, 0x00>();  // BufferID, PageID
+static constexpr auto FRAME_MATCH = make_command_frame<C::CMD_MATCH>();
+static constexpr auto FRAME_UP_CHAR = make_command_frame<C::CMD_UP_CHAR, 0x00>();      // BufferID
+static constexpr auto FRAME_DOWN_CHAR = make_command_frame<C::CMD_DOWN_CHAR, 0x00>();  // BufferID
+static constexpr auto FRAME_SET_CHIP_ADDR = make_command_frame<C::CMD_SET_CHIP_ADDR, 0x00, 0x00, 0x00, 0x00>();  // 新地址
+static constexpr auto FRAME_DEL_CHAR = make_command_frame<C::CMD_DEL_CHAR, 0x00, 0x00, 0x00, 0x01>();  // PageID, N
+// 功能码, 起始颜色, 结束颜色/占空比, 循环次数, 周期(0x0F=1.5秒), 保留
+static constexpr auto FRAME_RGB_CTRL = make_command_frame<C::CMD_RGB_CTRL, 0x00, 0x00, 0x00, 0x00, 0x0F, 0x00>();
+// PageID, 录入次数, 参数 (0x0010: bit4=1 不允许重复指纹; 其余位为0: 上报各阶段结果, 每次采集之间要求手指离开)
+static constexpr auto FRAME_AUTO_ENROLL =
+    make_command_frame<C::CMD_AUTO_ENROLL, 0x00, 0x00, C::AUTO_ENROLL_SAMPLES, 0x00, 0x10>();
+// 安全等级2, StartPage, PageNum, 参数 (0: 上报各阶段结果)
+static constexpr auto FRAME_AUTO_MATCH =
+    make_command_frame<C::CMD_AUTO_MATCH, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00>();
+
+// 与原始C代码中的固定数组逐字节一致
+static_assert(FRAME_GET_IMAGE.data[10] == 0x00 && FRAME_GET_IMAGE.data[11] == 0x05, "GetImage checksum");
+static_assert(FRAME_HANDSHAKE.data[10] == 0x00 && FRAME_HANDSHAKE.data[11] == 0x39, "Handshake checksum");
+static_assert(FRAME_SEARCH.SIZE == 17 && FRAME_RGB_CTRL.SIZE == 18 && FRAME_AUTO_ENROLL.SIZE == 17 &&
+                  FRAME_AUTO_MATCH.SIZE == 19,
+              "frame size");
+
+ZW101Component *ZW101Component::instances_ = nullptr;
+
+ZW101Component::~ZW101Component() { leave_bus(); }
+
 void ZW101Component::setup() {
-  ESP_LOGI(TAG, "Initializing ZW101 Fingerprint Module");
+  ESP_LOGI(TAG, "Initializing ZW101 Fingerprint Module (address 0x%08X)", (unsigned) address_);
+  join_bus();
 
   // 初始化搜索状态
   search_last_action_ = millis();
 
-  // 延迟读取模组信息,在 loop 中第一次运行时读取
-  read_fp_info();  // 暂时注释,避免启动阻塞
+  // 指纹库重排的 ID 映射; 上次有未完成的搬移时, 先按日志处理完再开始搜索
+  remap_pref_ = global_preferences->make_preference<PageRemap>(remap_key_ ^ address_, true);
+  if (!remap_pref_.load(&remap_))
+    remap_ = PageRemap();
+  if (remap_.size() > 0)
+    ESP_LOGI(TAG, "%u remapped template IDs", remap_.size());
+  if (remap_.move_state() != PageRemap::MOVE_NONE) {
+    ESP_LOGW(TAG, "Template move %u -> %u was interrupted, resuming", remap_.move_src(), remap_.move_dst());
+    relocating_ = true;
+    relocate_retry_at_ = millis() + RELOCATE_RETRY_MS;
+  }
+
+  // 配置了触摸引脚时由中断唤醒搜索, 空闲期间不再轮询模组
+  if (touch_pin_ != nullptr) {
+    touch_pin_->setup();
+    touch_pin_->attach_interrupt(&ZW101Component::touch_isr, this, gpio::INTERRUPT_RISING_EDGE);
+    ESP_LOGI(TAG, "Touch wake-up enabled");
+  }
+
+  // 读取模组信息: 指令入队, 在 loop 中异步完成, 不阻塞启动
+  // 配置了目标波特率时先完成波特率协商, 再读取模组信息
+  if (target_baud_rate_ != 0) {
+    negotiate_baud_rate();
+  } else {
+    info_read_ = true;
+    read_fp_info();
+  }
 }
 
 void ZW101Component::loop() {
   uint32_t now = millis();
 
+  // 推进指令队列: 接收应答、处理超时、发送下一条指令
+  process_command_queue();
+
   // 启动后0.5秒立即关闭LED(避免模组默认灯光)
-  static bool led_off_sent = false;
-  if (!led_off_sent && now > 500) {
-    led_off_sent = true;
+  if (!led_off_sent_ && now > 500) {
+    led_off_sent_ = true;
     set_rgb_led(4, 0, 0);
     ESP_LOGI(TAG, "LED turned off");
   }
 
+  // 灯控请求在指令间隙发出
+  flush_led();
+
+  // 波特率协商期间不发起其他指令
+  if (baud_negotiating_)
+    return;
+
+  // 连续超时: 模组可能断电重启后回到了其他波特率, 重新探测 (休眠期间的超时是预期的)
+  if (power_state_ == POWER_AWAKE && target_baud_rate_ != 0 && consecutive_timeouts_ >= BAUD_REPROBE_TIMEOUTS &&
+      now - last_baud_negotiation_ > BAUD_REPROBE_INTERVAL_MS) {
+    ESP_LOGW(TAG, "%u consecutive timeouts, probing baud rate again", consecutive_timeouts_);
+    negotiate_baud_rate();
+    return;
+  }
+
+  // 定期发布指令延迟统计
+  if (!latency_sensors_.empty() && now - last_stats_publish_ > STATS_PUBLISH_INTERVAL_MS) {
+    last_stats_publish_ = now;
+    publish_command_stats();
+  }
+
   // 检查自动模式超时
-  if (auto_mode_active_ && auto_mode_timeout_ > 0 && now >= auto_mode_timeout_) {
+  if (auto_mode_ != AUTO_MODE_NONE && auto_mode_timeout_ > 0 && now >= auto_mode_timeout_) {
     ESP_LOGW(TAG, "Auto mode timeout, cancelling");
     cancel_auto_mode();
   }
@@ -40,14 +139,40 @@ void ZW101Component::loop() {
       fingerprint_sensor_->publish_state(false);
   }
 
+  // 休眠、唤醒过程中不发起搜索和注册
+  if (power_state_ != POWER_AWAKE) {
+    process_power();
+    return;
+  }
+  // 模板搬移进行中暂停搜索和注册 (触摸标志保留到搬移结束); 出错后按间隔重试
+  if (relocating_) {
+    if (relocate_retry_at_ != 0 && (int32_t) (now - relocate_retry_at_) >= 0)
+      resume_relocation();
+    return;
+  }
+  // 空闲窗口先用于重排, 没有可做的搬移时才休眠
+  if (idle_for_relocation(now)) {
+    uint16_t src, dst;
+    if (plan_relocation(&src, &dst)) {
+      start_relocation(src, dst);
+      return;
+    }
+    relocate_pending_ = false;
+  }
+  if (idle_for_sleep(now)) {
+    ESP_LOGD(TAG, "Idle for %u ms, entering sleep", (unsigned) sleep_timeout_ms_);
+    enter_sleep_mode();
+    return;
+  }
+
   // 处理注册流程
   if (enroll_state_ != ENROLL_IDLE) {
     process_enrollment();
     return;  // 注册过程中不进行自动搜索
   }
 
-  // 如果在自动模式或休眠模式,不进行主动搜索
-  if (auto_mode_active_ || sleep_mode_) {
+  // 如果在自动模式或休眠模式,不进行主动搜索; 自动验证出结果后的等待抬起仍由搜索流程处理
+  if ((auto_mode_ != AUTO_MODE_NONE && !rearm_after_lift_) || !search_enabled_) {
     return;
   }
 
@@ -56,121 +181,384 @@ void ZW101Component::loop() {
 }
 
 // 非阻塞式搜索流程处理
+// 采图、生成特征、搜索在应答回调中依次发出 (见 search_capture), 这里只负责启动、重试和等待抬起
 void ZW101Component::process_search() {
   uint32_t now = millis();
 
   switch (search_state_) {
-    case SEARCH_IDLE:
-      // 每1秒启动一次新搜索
-      if (now - search_last_action_ > 1000) {
-        search_state_ = SEARCH_GET_IMAGE;
-        search_retry_count_ = 0;
-        search_last_action_ = now;
+    case SEARCH_IDLE: {
+      // 触摸中断到来立即开始采图; 手指一直按着或未配置触摸引脚时按自适应间隔启动新搜索
+      bool touched = touch_triggered_;
+      touch_triggered_ = false;
+      if (!touched && (now - search_last_action_ <= poll_interval_ || !finger_present()))
+        break;
+      search_retry_count_ = 0;
+      search_last_action_ = now;
+      // 未配置触摸引脚时先做在位探测, 报告有手指才采图; 不支持探测指令时采图本身就是探测
+      if (touched || touch_pin_ != nullptr || !check_finger_supported_) {
+        search_capture();
+      } else if (probe_finger([this](bool present) {
+                   if (present) {
+                     search_capture();
+                     return;
+                   }
+                   search_last_action_ = millis();
+                   decay_poll_interval();
+                   search_state_ = SEARCH_IDLE;
+                 })) {
+        search_state_ = SEARCH_WAIT_REPLY;
       }
       break;
+    }
 
     case SEARCH_GET_IMAGE:
-      // 获取图像
-      send_cmd(CMD_GET_IMAGE);
-      if (receive_response()) {
-        // 成功读取图像,进入生成特征
-        search_state_ = SEARCH_GEN_CHAR;
-      } else {
-        // 没有检测到指纹,进入等待重试
-        search_state_ = SEARCH_WAIT_RETRY;
-        search_last_action_ = now;
-      }
-      break;
-
-    case SEARCH_GEN_CHAR:
-      // 生成特征
-      send_cmd2(CMD_GEN_CHAR, 1);
-      if (receive_response()) {
-        // 特征生成成功,进行搜索
-        search_state_ = SEARCH_DO_SEARCH;
-      } else {
-        // 特征生成失败
-        search_retry_count_++;
-        if (search_retry_count_ >= 5) {
-          // 达到最大重试次数,返回空闲
-          if (status_sensor_)
-            status_sensor_->publish_state("No Valid Fingerprint");
-          search_state_ = SEARCH_IDLE;
-          search_last_action_ = now;
-        } else {
-          // 重试
-          search_state_ = SEARCH_WAIT_RETRY;
-          search_last_action_ = now;
-        }
-      }
+      // 回调中入队失败 (队列已满) 时由 loop 重试
+      search_capture();
       break;
 
     case SEARCH_WAIT_RETRY:
-      // 等待500ms后重试
-      if (now - search_last_action_ > 500) {
-        search_state_ = SEARCH_GET_IMAGE;
+      // 手指已离开则不再重试, 等待下一次触摸
+      if (!finger_present()) {
+        search_state_ = SEARCH_IDLE;
+        break;
+      }
+      // 按最短轮询间隔重试
+      if (now - search_last_action_ > min_poll_interval_) {
+        search_capture();
       }
       break;
 
     case SEARCH_DO_SEARCH:
-      // 搜索指纹库 - 从Page 0开始,搜索整个库
-      send_search_cmd(1, 0, library_capacity_);
-
-      uint8_t response[50];
-      uint8_t length = wait_for_response(response, 50, 500);
+      // 回调中入队失败 (队列已满) 时由 loop 重试
+      search_current_range();
+      break;
 
-      // 调试: 打印完整响应包
-      if (length > 0) {
-        ESP_LOGI(TAG, "Search response length: %d", length);
-        ESP_LOG_BUFFER_HEX(TAG, response, length);
+    case SEARCH_WAIT_LIFT:
+      // 配置了触摸引脚时直接读电平, 不占用串口
+      if (touch_pin_ != nullptr) {
+        if (!finger_present())
+          finish_lift_wait();
+        break;
       }
+      // 否则按最短轮询间隔做在位探测, 不提取特征和搜索
+      if (now - search_last_action_ > min_poll_interval_ && probe_finger([this](bool present) {
+            search_last_action_ = millis();
+            if (present) {
+              search_state_ = SEARCH_WAIT_LIFT;
+            } else {
+              finish_lift_wait();
+            }
+          }))
+        search_state_ = SEARCH_WAIT_REPLY;
+      break;
 
-      if (length >= 12 && response[9] == 0x00) {
-        // 搜索命令执行成功,检查是否真的找到匹配
-        uint16_t match_page = (response[10] << 8) | response[11];
-        uint16_t match_score = (response[12] << 8) | response[13];
-
-        ESP_LOGI(TAG, "Search response - Page: %d (0x%04X), Score: %d", match_page, match_page, match_score);
-
-        // 判断是否真的找到匹配:
-        // - 0xFFFF 表示未找到匹配
-        // - 有效的页码应该在 0 到 library_capacity_ 范围内
-        if (match_page != 0xFFFF && match_page < library_capacity_) {
-          // 真正的匹配成功
-          ESP_LOGI(TAG, "Match found! Page: %d, Score: %d", match_page, match_score);
-
-          if (fingerprint_sensor_)
-            fingerprint_sensor_->publish_state(true);
-          if (match_id_sensor_)
-            match_id_sensor_->publish_state(match_page);  // Page号就是显示的ID
-          if (match_score_sensor_)
-            match_score_sensor_->publish_state(match_score);
-          if (status_sensor_)
-            status_sensor_->publish_state("Match Found");
+    case SEARCH_WAIT_REPLY:
+      // 等待应答回调推进状态
+      break;
+  }
+}
 
-          // 设置匹配标志,3秒后自动清除
-          match_found_ = true;
-          match_clear_time_ = now + 3000;
+// 采图, 之后生成特征和搜索都在应答回调中直接发出, 不等下一次 loop
+void ZW101Component::search_capture() {
+  if (capture_features(false, 1, [this](uint8_t cmd, uint8_t code) {
+        search_last_action_ = millis();
+        if (cmd == CMD_GET_IMAGE && (code == ACK_NO_FINGER || code == ACK_TIMEOUT)) {
+          // 没有检测到指纹, 本次为空轮询, 回到空闲并放慢轮询
+          decay_poll_interval();
+          search_state_ = SEARCH_IDLE;
+          return;
+        }
+        note_search_activity();
+        if (code == ACK_SUCCESS) {
+          // 特征生成成功,按占用情况规划搜索区间
+          search_range_count_ = plan_search_ranges(search_ranges_, MAX_SEARCH_RANGES);
+          search_range_index_ = 0;
+          search_pages_ = 0;
+          if (search_range_count_ == 0) {
+            // 指纹库为空, 不必搜索
+            if (status_sensor_)
+              status_sensor_->publish_state("No Match");
+            wait_for_lift();
+            return;
+          }
+          // 模板传输占用缓冲区2, 期间不做候选比对
+          candidate_index_ = 0;
+          candidate_tries_ = transfer_active_ ? 0 : plan_candidates();
+          if (candidate_tries_ > 0) {
+            match_candidate();
+            return;
+          }
+          search_current_range();
+          return;
+        }
+        // 有手指但采图或特征生成失败
+        if (++search_retry_count_ >= 5) {
+          // 达到最大重试次数,等待手指离开后再开始新的搜索
+          if (cmd == CMD_GEN_CHAR && status_sensor_)
+            status_sensor_->publish_state("No Valid Fingerprint");
+          wait_for_lift();
         } else {
-          // 未匹配
-          ESP_LOGD(TAG, "No match found (Page=0x%04X)", match_page);
-          if (status_sensor_)
-            status_sensor_->publish_state("No Match");
+          search_state_ = SEARCH_WAIT_RETRY;
         }
-      } else if (length >= 12 && response[9] == 0x09) {
-        // 0x09 = PS_NOT_SEARCHED: 没有搜索到匹配
-        ESP_LOGD(TAG, "Search returned: No match (0x09)");
-        if (status_sensor_)
-          status_sensor_->publish_state("No Match");
-      }
+      })) {
+    search_state_ = SEARCH_WAIT_REPLY;
+  } else {
+    search_state_ = SEARCH_GET_IMAGE;
+  }
+}
 
-      // 搜索完成,返回空闲状态
-      search_state_ = SEARCH_IDLE;
-      search_last_action_ = now;
-      break;
+// 搜索当前区间, 在应答回调中调用时与上一条指令在同一次 loop 中发出
+void ZW101Component::search_current_range() {
+  const TemplateIndex::PageRange &range = search_ranges_[search_range_index_];
+  if (send_search_cmd(1, range.start, range.count, [this](uint8_t code, const uint8_t *frame, uint16_t length) {
+        handle_search_reply(code, frame, length);
+      })) {
+    search_pages_ += range.count;
+    search_state_ = SEARCH_WAIT_REPLY;
+  } else {
+    search_state_ = SEARCH_DO_SEARCH;
+  }
+}
+
+// 本次要比对的候选: 列表前 candidate_count_ 页中值得比对的页, 已在缓冲区2的排到最前。
+// 命中一页省下一次搜索, 按该页在匹配中的占比折算后不及一次读出加比对的耗时, 就不比对该页;
+// 耗时取自指令延迟统计, 还没有统计时全部比对
+uint8_t ZW101Component::plan_candidates() {
+  const CommandLatency *search = command_stats_.find(CMD_SEARCH);
+  const CommandLatency *load = command_stats_.find(CMD_LOAD_CHAR);
+  const CommandLatency *match = command_stats_.find(CMD_MATCH);
+  bool measured = search != nullptr && load != nullptr && match != nullptr && search->count > 0 &&
+                  load->count > 0 && match->count > 0;
+  uint32_t total = candidates_.total_hits();
+
+  uint8_t tries = 0;
+  for (uint8_t i = 0; i < candidates_.count() && i < candidate_count_; i++) {
+    uint16_t page = candidates_.at(i);
+    if (measured && total > 0) {
+      uint32_t cost = match->avg_us() + (page == loaded_candidate_ ? 0 : load->avg_us());
+      uint64_t gain = static_cast<uint64_t>(search->avg_us()) * candidates_.hits(i) / total;
+      if (gain < cost)
+        continue;
+    }
+    candidate_order_[tries++] = page;
+  }
+  for (uint8_t i = 1; i < tries; i++) {
+    if (candidate_order_[i] == loaded_candidate_) {
+      candidate_order_[i] = candidate_order_[0];
+      candidate_order_[0] = loaded_candidate_;
+    }
+  }
+  return tries;
+}
+
+// 候选比对: 读出候选页模板到缓冲区2, 与缓冲区1的特征 1:1 比对; 入队失败时直接退回搜索
+void ZW101Component::match_candidate() {
+  uint16_t page = candidate_order_[candidate_index_];
+  if (page == loaded_candidate_) {
+    compare_candidate(page);
+    return;
+  }
+
+  auto load = FRAME_LOAD_CHAR;
+  load.set_u8(10, TRANSFER_BUFFER).set_u16(11, page);
+  loaded_candidate_ = NO_PAGE;
+  if (!send_frame(load, COMMON_TIMEOUT, [this, page](uint8_t code, const uint8_t *, uint16_t) {
+        if (code != ACK_SUCCESS) {
+          // 页已空或读出失败, 不再作为候选
+          ESP_LOGD(TAG, "Candidate page %u not loadable (0x%02X)", page, code);
+          candidates_.remove(page);
+          next_candidate();
+          return;
+        }
+        // 读出期间开始了模板传输: 缓冲区2 即将被覆盖, 放弃候选比对
+        if (transfer_active_) {
+          search_current_range();
+          return;
+        }
+        loaded_candidate_ = page;
+        compare_candidate(page);
+      })) {
+    search_current_range();
+    return;
+  }
+  search_state_ = SEARCH_WAIT_REPLY;
+}
+
+void ZW101Component::compare_candidate(uint16_t page) {
+  if (!send_frame(FRAME_MATCH, MATCH_TIMEOUT, [this, page](uint8_t code, const uint8_t *frame, uint16_t length) {
+        if (code != ACK_SUCCESS || length < 12) {
+          next_candidate();
+          return;
+        }
+        uint16_t score = (frame[10] << 8) | frame[11];
+        ESP_LOGD(TAG, "Candidate page %u matched, score %u", page, score);
+        candidate_hits_++;
+        publish_candidate_hit_rate();
+        note_search_activity();
+        publish_match(page, score);
+        wait_for_lift();
+      })) {
+    search_current_range();
+    return;
+  }
+  search_state_ = SEARCH_WAIT_REPLY;
+}
+
+// 下一个候选; 全部未命中时做 1:N 搜索
+void ZW101Component::next_candidate() {
+  if (++candidate_index_ < candidate_tries_) {
+    match_candidate();
+    return;
+  }
+  candidate_misses_++;
+  publish_candidate_hit_rate();
+  search_current_range();
+}
+
+void ZW101Component::publish_candidate_hit_rate() {
+  if (candidate_hit_rate_sensor_)
+    candidate_hit_rate_sensor_->publish_state(100.0f * candidate_hits_ / (candidate_hits_ + candidate_misses_));
+}
+
+// 出结果后手指通常还按着, 立即重新搜索会再次匹配并重复上报; 等手指离开后再开始下一次
+void ZW101Component::wait_for_lift() {
+  search_state_ = SEARCH_WAIT_LIFT;
+  search_last_action_ = millis();
+}
+
+void ZW101Component::finish_lift_wait() {
+  ESP_LOGD(TAG, "Finger lifted");
+  search_state_ = SEARCH_IDLE;
+  search_last_action_ = millis();
+  if (!rearm_after_lift_)
+    return;
+  rearm_after_lift_ = false;
+  if (auto_mode_ == AUTO_MODE_MATCH && !arm_auto_match()) {
+    ESP_LOGW(TAG, "Failed to re-arm auto match, leaving auto mode");
+    auto_mode_ = AUTO_MODE_NONE;
+  }
+}
+
+// 触摸引脚电平: 手指按在传感器上时为高
+bool ZW101Component::finger_present() { return touch_pin_ == nullptr || touch_pin_->digital_read(); }
+
+// 在位探测: PS_CheckFinger 只读取传感器的触摸检测, 不点亮传感器采图, 应答也比采图快得多。
+// 模组返回其他确认码 (固件不认识该指令) 时, 之后改用采图探测;
+// 判定不支持的那一次按有手指处理, 由调用方接下来的采图确认。超时与采图一样按无手指处理
+bool ZW101Component::probe_finger(ResultCallback on_done) {
+  if (!check_finger_supported_) {
+    return send_frame(FRAME_GET_IMAGE, CAPTURE_TIMEOUT, [on_done](uint8_t code, const uint8_t *, uint16_t) {
+      on_done(code != ACK_NO_FINGER && code != ACK_TIMEOUT);
+    });
+  }
+
+  return send_frame(FRAME_CHECK_FINGER, CAPTURE_TIMEOUT, [this, on_done](uint8_t code, const uint8_t *, uint16_t) {
+    if (code == ACK_SUCCESS || code == ACK_NO_FINGER || code == ACK_TIMEOUT) {
+      on_done(code == ACK_SUCCESS);
+      return;
+    }
+    ESP_LOGW(TAG, "CHECK_FINGER not supported (0x%02X), probing with GET_IMAGE", code);
+    check_finger_supported_ = false;
+    on_done(true);
+  });
+}
+
+// 有活动时回到最短轮询间隔
+void ZW101Component::note_search_activity() {
+  last_activity_ = millis();
+  if (poll_interval_ != min_poll_interval_) {
+    poll_interval_ = min_poll_interval_;
+    publish_poll_interval();
+  }
+}
+
+// 空轮询: 活动后保持一段时间的最短间隔, 之后每次放慢1.5倍
+void ZW101Component::decay_poll_interval() {
+  if (millis() - last_activity_ < POLL_ACTIVE_HOLD_MS || poll_interval_ >= max_poll_interval_)
+    return;
+  poll_interval_ = std::min(max_poll_interval_, poll_interval_ + poll_interval_ / 2);
+  publish_poll_interval();
+}
+
+void ZW101Component::publish_poll_interval() {
+  ESP_LOGD(TAG, "Poll interval: %u ms", (unsigned) poll_interval_);
+  if (poll_interval_sensor_)
+    poll_interval_sensor_->publish_state(poll_interval_);
+}
+
+// 触摸中断: 只置标志, 由 loop 启动采图
+void IRAM_ATTR ZW101Component::touch_isr(ZW101Component *arg) { arg->touch_triggered_ = true; }
+
+// 规划搜索区间: 索引表可用时只覆盖已占用的页, 否则退回整库搜索
+uint8_t ZW101Component::plan_search_ranges(TemplateIndex::PageRange *ranges, uint8_t max_ranges) {
+  if (!template_index_.is_loaded()) {
+    ranges[0] = {0, library_capacity_};
+    return 1;
+  }
+  return template_index_.covering_ranges(ranges, max_ranges, SEARCH_SPLIT_GAP);
+}
+
+// 处理搜索应答
+void ZW101Component::handle_search_reply(uint8_t code, const uint8_t *frame, uint16_t length) {
+  // 当前区间未命中, 立即搜索下一个区间
+  if (code == ACK_NOT_SEARCHED && search_range_index_ + 1 < search_range_count_) {
+    search_range_index_++;
+    search_current_range();
+    return;
+  }
+
+  if (search_pages_sensor_)
+    search_pages_sensor_->publish_state(search_pages_);
+
+  if (length >= 14 && code == ACK_SUCCESS) {
+    // 搜索命令执行成功,检查是否真的找到匹配
+    uint16_t match_page = (frame[10] << 8) | frame[11];
+    uint16_t match_score = (frame[12] << 8) | frame[13];
+
+    ESP_LOGD(TAG, "Search response - Page: %d (0x%04X), Score: %d", match_page, match_page, match_score);
+
+    // 判断是否真的找到匹配:
+    // - 0xFFFF 表示未找到匹配
+    // - 有效的页码应该在 0 到 library_capacity_ 范围内
+    if (match_page != 0xFFFF && match_page < library_capacity_) {
+      // 真正的匹配成功
+      note_search_activity();
+      publish_match(match_page, match_score);
+    } else {
+      // 未匹配
+      ESP_LOGD(TAG, "No match found (Page=0x%04X)", match_page);
+      if (status_sensor_)
+        status_sensor_->publish_state("No Match");
+    }
+  } else if (code == ACK_NOT_SEARCHED) {
+    // 0x09 = PS_NOT_SEARCHED: 没有搜索到匹配
+    ESP_LOGD(TAG, "Search returned: No match (0x09)");
+    if (status_sensor_)
+      status_sensor_->publish_state("No Match");
   }
 
-  yield();  // 让出CPU时间
+  // 搜索完成, 等待手指离开
+  wait_for_lift();
+}
+
+// 发布匹配结果, 3秒后自动清除; 发布的是模板的 ID, 重排后与页号不同
+void ZW101Component::publish_match(uint16_t page, uint16_t score) {
+  uint16_t id = template_id(page);
+  ESP_LOGI(TAG, "Match found! ID: %d (page %d), Score: %d", id, page, score);
+
+  if (fingerprint_sensor_)
+    fingerprint_sensor_->publish_state(true);
+  if (match_id_sensor_)
+    match_id_sensor_->publish_state(id);
+  if (match_score_sensor_)
+    match_score_sensor_->publish_state(score);
+  if (status_sensor_)
+    status_sensor_->publish_state("Match Found");
+
+  match_found_ = true;
+  match_clear_time_ = millis() + 3000;
+  candidates_.record(page);
+  relocate_pending_ = true;
 }
 
 // 非阻塞式注册流程处理
@@ -180,41 +568,35 @@ void ZW101Component::process_enrollment() {
   switch (enroll_state_) {
     case ENROLL_WAIT_FINGER:
       // 等待手指放置
+      if (now - enroll_wait_start_ > 30000) {
+        // 超时30秒
+        if (status_sensor_)
+          status_sensor_->publish_state("Enroll Timeout");
+        enroll_state_ = ENROLL_IDLE;
+        break;
+      }
       if (now - enroll_last_action_ > 200) {  // 每200ms检查一次
         enroll_last_action_ = now;
-        send_cmd(CMD_GET_IMAGE_ENROLL);  // 使用注册模式采图命令 0x29
-
-        if (receive_response()) {
-          // 检测到手指,开始生成特征
-          enroll_state_ = ENROLL_CAPTURING;
-          ESP_LOGI(TAG, "Finger detected, capturing sample %d/5", enroll_sample_count_ + 1);
-        } else if (now - enroll_last_action_ > 30000) {
-          // 超时30秒
-          if (status_sensor_)
-            status_sensor_->publish_state("Enroll Timeout");
-          enroll_state_ = ENROLL_IDLE;
-        }
-      }
-      break;
-
-    case ENROLL_CAPTURING:
-      // 生成特征
-      send_cmd2(CMD_GEN_CHAR, enroll_sample_count_ + 1);
-      if (receive_response()) {
-        enroll_sample_count_++;
-        ESP_LOGI(TAG, "Sample %d captured", enroll_sample_count_);
-
-        if (enroll_sample_count_ >= 5) {
-          // 收集完成,开始合并
-          enroll_state_ = ENROLL_MERGING;
-        } else {
-          // 等待手指移开
-          enroll_state_ = ENROLL_WAIT_REMOVE;
-          enroll_last_action_ = now;
-        }
-      } else {
-        // 失败,返回等待
-        enroll_state_ = ENROLL_WAIT_FINGER;
+        // 使用注册模式采图命令 0x29, 采到图像后在回调中直接生成特征
+        if (capture_features(true, enroll_sample_count_ + 1, [this](uint8_t cmd, uint8_t code) {
+              if (code != ACK_SUCCESS) {
+                // 无手指或采集失败, 继续等待
+                enroll_state_ = ENROLL_WAIT_FINGER;
+                return;
+              }
+              enroll_sample_count_++;
+              ESP_LOGI(TAG, "Sample %d captured", enroll_sample_count_);
+
+              if (enroll_sample_count_ >= 5) {
+                // 收集完成,立即合并
+                enroll_merge();
+              } else {
+                // 等待手指移开
+                enroll_state_ = ENROLL_WAIT_REMOVE;
+                enroll_last_action_ = millis();
+              }
+            }))
+          enroll_state_ = ENROLL_WAIT_REPLY;
       }
       break;
 
@@ -224,52 +606,85 @@ void ZW101Component::process_enrollment() {
         ESP_LOGI(TAG, "Remove finger and place again (%d/5)", enroll_sample_count_);
         enroll_state_ = ENROLL_WAIT_FINGER;
         enroll_last_action_ = now;
+        enroll_wait_start_ = now;
       }
       break;
 
     case ENROLL_MERGING:
-      // 合并特征
-      send_cmd(CMD_REG_MODEL);
-      if (receive_response()) {
-        enroll_state_ = ENROLL_STORING;
-      } else {
-        if (status_sensor_)
-          status_sensor_->publish_state("Enroll Failed - Merge");
-        enroll_state_ = ENROLL_IDLE;
-      }
+      // 回调中入队失败 (队列已满) 时由 loop 重试
+      enroll_merge();
       break;
 
     case ENROLL_STORING:
-      // 存储模板
-      send_store_cmd(1, next_fingerprint_id_);  // 使用下一个可用ID
-      if (receive_response()) {
-        ESP_LOGI(TAG, "Fingerprint enrolled successfully as ID %d", next_fingerprint_id_);
-
-        if (status_sensor_) {
-          char buf[64];
-          snprintf(buf, sizeof(buf), "Enroll Success (ID: %d)", next_fingerprint_id_);
-          status_sensor_->publish_state(buf);
-        }
+      enroll_store();
+      break;
 
-        // 存储成功后递增ID
-        next_fingerprint_id_++;
-        if (next_fingerprint_id_ >= library_capacity_) {
-          next_fingerprint_id_ = 0;  // 超过容量则从0开始循环
-        }
-        ESP_LOGI(TAG, "Next fingerprint will use ID: %d", next_fingerprint_id_);
-      } else {
-        if (status_sensor_)
-          status_sensor_->publish_state("Enroll Failed - Store");
-      }
-      enroll_state_ = ENROLL_IDLE;
+    case ENROLL_WAIT_REPLY:
+      // 等待应答回调推进状态
       break;
 
     default:
       enroll_state_ = ENROLL_IDLE;
       break;
   }
+}
+
+// 合并特征, 成功后在回调中直接存储
+void ZW101Component::enroll_merge() {
+  if (send_frame(FRAME_REG_MODEL, COMMON_TIMEOUT, [this](uint8_t code, const uint8_t *, uint16_t) {
+        if (code == ACK_SUCCESS) {
+          enroll_store();
+        } else {
+          if (status_sensor_)
+            status_sensor_->publish_state("Enroll Failed - Merge");
+          enroll_state_ = ENROLL_IDLE;
+        }
+      })) {
+    enroll_state_ = ENROLL_WAIT_REPLY;
+  } else {
+    enroll_state_ = ENROLL_MERGING;
+  }
+}
 
-  yield();  // 让出CPU时间,避免看门狗超时
+// 存储模板, 使用索引表中第一个空闲页, 不会覆盖已有模板
+void ZW101Component::enroll_store() {
+  if (!template_index_.is_loaded()) {
+    ESP_LOGW(TAG, "Index table not available, refusing to store");
+    if (status_sensor_)
+      status_sensor_->publish_state("Enroll Failed - Store");
+    enroll_state_ = ENROLL_IDLE;
+    return;
+  }
+  int free_page = template_index_.find_free();
+  if (free_page < 0) {
+    ESP_LOGW(TAG, "Fingerprint library full");
+    if (status_sensor_)
+      status_sensor_->publish_state("Enroll Failed - Library Full");
+    enroll_state_ = ENROLL_IDLE;
+    return;
+  }
+  uint16_t page = free_page;
+  if (send_store_cmd(1, page, [this, page](uint8_t code, const uint8_t *, uint16_t) {
+        if (code == ACK_SUCCESS) {
+          template_index_.set_used(page, true);
+          uint16_t id = remap_.id_of(page);
+          ESP_LOGI(TAG, "Fingerprint enrolled successfully as ID %d", id);
+
+          if (status_sensor_) {
+            char buf[64];
+            snprintf(buf, sizeof(buf), "Enroll Success (ID: %d)", id);
+            status_sensor_->publish_state(buf);
+          }
+        } else {
+          if (status_sensor_)
+            status_sensor_->publish_state("Enroll Failed - Store");
+        }
+        enroll_state_ = ENROLL_IDLE;
+      })) {
+    enroll_state_ = ENROLL_WAIT_REPLY;
+  } else {
+    enroll_state_ = ENROLL_STORING;
+  }
 }
 
 // 注册指纹 - 启动非阻塞流程
@@ -278,290 +693,528 @@ bool ZW101Component::register_fingerprint() {
     ESP_LOGW(TAG, "Enrollment already in progress");
     return false;
   }
+  loaded_candidate_ = NO_PAGE;  // 注册采集会写入缓冲区2
 
   if (status_sensor_)
     status_sensor_->publish_state("Enrolling...");
   ESP_LOGI(TAG, "Starting fingerprint enrollment");
 
+  // 索引表尚未读到(例如启动时读取失败)时补读一次, 存储前完成即可
+  if (!template_index_.is_loaded())
+    read_index_table();
+
   enroll_state_ = ENROLL_WAIT_FINGER;
   enroll_sample_count_ = 0;
   enroll_last_action_ = millis();
+  enroll_wait_start_ = enroll_last_action_;
 
   ESP_LOGI(TAG, "Place finger (sample 1/5)");
   return true;
 }
 
 // 清空指纹库
-bool ZW101Component::clear_fingerprint_library() {
+bool ZW101Component::clear_fingerprint_library(ResultCallback on_done) {
+  if (relocation_blocks())
+    return false;
   ESP_LOGI(TAG, "Clearing fingerprint library");
   if (status_sensor_)
     status_sensor_->publish_state("Clearing Library...");
 
-  send_cmd(CMD_CLEAR_LIB);
-  if (receive_response()) {
-    if (status_sensor_)
-      status_sensor_->publish_state("Library Cleared");
-    ESP_LOGI(TAG, "Library cleared successfully");
-    next_fingerprint_id_ = 0;  // 重置ID从0开始
-    return true;
-  }
-
-  if (status_sensor_)
-    status_sensor_->publish_state("Clear Failed");
-  return false;
+  return send_frame(FRAME_CLEAR_LIB, EMPTY_TIMEOUT, [this, on_done](uint8_t code, const uint8_t *, uint16_t) {
+    bool ok = code == ACK_SUCCESS;
+    if (ok) {
+      if (status_sensor_)
+        status_sensor_->publish_state("Library Cleared");
+      ESP_LOGI(TAG, "Library cleared successfully");
+      template_index_.clear();
+      candidates_.clear();
+      loaded_candidate_ = NO_PAGE;
+      if (remap_.size() > 0) {
+        remap_.clear();
+        save_remap();
+      }
+    } else {
+      if (status_sensor_)
+        status_sensor_->publish_state("Clear Failed");
+    }
+    if (on_done)
+      on_done(ok);
+  });
 }
 
 // 读取模组信息
 void ZW101Component::read_fp_info() {
-  uint8_t response[32];
-
-  // 首先读取系统参数获取指纹库容量
-  send_cmd(CMD_READ_SYSPARA);
-  uint8_t length = wait_for_response(response, 32, 2000);
-
-  if (length >= 28 && response[9] == 0x00) {
-    uint16_t fp_lib_size = (response[14] << 8) | response[15];
-    library_capacity_ = fp_lib_size;
-    ESP_LOGI(TAG, "Library capacity: %d", fp_lib_size);
-  }
-
-  // 然后读取实际已注册数量 (更准确)
-  uint8_t packet[12];
-  uint16_t pkt_length = 3;
-  uint16_t checksum = 1 + pkt_length + CMD_READ_VALID_NUMS;
-
-  build_packet_header(packet, pkt_length);
-  packet[9] = CMD_READ_VALID_NUMS;
-  packet[10] = (checksum >> 8) & 0xFF;
-  packet[11] = checksum & 0xFF;
-
-  write_array(packet, 12);
-  flush();
-
-  uint8_t resp_len = wait_for_response(response, 32, 1000);
+  // 首先读取系统参数获取指纹库容量, 再按容量读取索引表
+  send_frame(FRAME_READ_SYSPARA, EMPTY_TIMEOUT, [this](uint8_t code, const uint8_t *frame, uint16_t length) {
+    if (length >= 28 && code == ACK_SUCCESS) {
+      uint16_t fp_lib_size = (frame[14] << 8) | frame[15];
+      library_capacity_ = fp_lib_size;
+      ESP_LOGI(TAG, "Library capacity: %d", fp_lib_size);
+      // 数据包大小 N: 32 << N 字节
+      if (frame[23] <= 3)
+        data_packet_size_ = 32 << frame[23];
+    }
 
-  if (resp_len >= 14 && response[9] == 0x00) {
-    uint16_t register_cnt = (response[10] << 8) | response[11];
-    next_fingerprint_id_ = register_cnt;  // 下一个ID = 已注册数量 (因为ID从0开始)
+    read_index_table([this](bool ok) {
+      if (!ok) {
+        ESP_LOGW(TAG, "Failed to read index table, will retry before enrollment");
+        return;
+      }
+      int next_id = template_index_.find_free();
+      ESP_LOGI(TAG, "Module Info - Registered: %d, Library Size: %d", template_index_.count(), library_capacity_);
+      ESP_LOGI(TAG, "Next available ID: %d", next_id);
+
+      if (status_sensor_) {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "Ready (Enrolled: %d/%d)", template_index_.count(), library_capacity_);
+        status_sensor_->publish_state(buf);
+      }
+    });
+  });
+}
 
-    ESP_LOGI(TAG, "Module Info - Registered: %d, Library Size: %d", register_cnt, library_capacity_);
-    ESP_LOGI(TAG, "Next available ID: %d", next_fingerprint_id_);
+// 读取索引表: 每张表覆盖256页, 按容量依次读取, 全部成功后位图生效
+bool ZW101Component::read_index_table(ResultCallback on_done) {
+  template_index_.set_capacity(library_capacity_);
+  template_index_.invalidate();
 
-    if (status_sensor_) {
-      char buf[64];
-      snprintf(buf, sizeof(buf), "Ready (Enrolled: %d/%d)", register_cnt, library_capacity_);
-      status_sensor_->publish_state(buf);
+  uint8_t tables = template_index_.table_count();
+  if (tables == 0) {
+    if (on_done)
+      on_done(false);
+    return false;
+  }
+  for (uint8_t table = 0; table < tables; table++) {
+    auto frame = FRAME_READ_INDEX_TABLE;
+    frame.set_u8(10, table);
+
+    bool last = table + 1 == tables;
+    ResultCallback done = last ? on_done : nullptr;
+    bool queued = send_frame(frame, COMMON_TIMEOUT, [this, table, last, done](uint8_t code, const uint8_t *frame,
+                                                                              uint16_t length) {
+      // 应答: 确认码 + 32字节索引表
+      if (code == ACK_SUCCESS && length >= FRAME_HEAD_SIZE + 1 + TemplateIndex::TABLE_BYTES + 2)
+        template_index_.load_table(table, &frame[VARIABLE_FIELD_START_POS]);
+      if (last && done)
+        done(template_index_.is_loaded());
+    });
+    if (!queued) {
+      if (on_done)
+        on_done(false);
+      return false;
     }
-  } else {
-    ESP_LOGW(TAG, "Failed to read template count, using ID=0");
-    next_fingerprint_id_ = 0;
   }
+  return true;
 }
 
 // 读取有效模板个数
-bool ZW101Component::read_valid_template_count() {
-  uint8_t packet[12];
-  uint16_t length = 3;
-  uint16_t checksum = 1 + length + CMD_READ_VALID_NUMS;
-
-  build_packet_header(packet, length);
-  packet[9] = CMD_READ_VALID_NUMS;
-  packet[10] = (checksum >> 8) & 0xFF;
-  packet[11] = checksum & 0xFF;
-
-  write_array(packet, 12);
-  flush();
-
-  uint8_t response[32];
-  uint8_t resp_len = wait_for_response(response, 32, 1000);
-
-  if (resp_len >= 14 && response[9] == 0x00) {
-    uint16_t template_count = (response[10] << 8) | response[11];
-    ESP_LOGI(TAG, "Valid template count: %d", template_count);
-
-    if (status_sensor_) {
-      char buf[64];
-      snprintf(buf, sizeof(buf), "Templates: %d", template_count);
-      status_sensor_->publish_state(buf);
-    }
-
-    return true;
-  }
-
-  ESP_LOGW(TAG, "Failed to read valid template count");
-  return false;
+bool ZW101Component::read_valid_template_count(ResultCallback on_done) {
+  return send_frame(FRAME_READ_VALID_NUMS, COMMON_TIMEOUT,
+                    [this, on_done](uint8_t code, const uint8_t *frame, uint16_t length) {
+                      bool ok = length >= 14 && code == ACK_SUCCESS;
+                      if (ok) {
+                        uint16_t template_count = (frame[10] << 8) | frame[11];
+                        ESP_LOGI(TAG, "Valid template count: %d", template_count);
+
+                        if (status_sensor_) {
+                          char buf[64];
+                          snprintf(buf, sizeof(buf), "Templates: %d", template_count);
+                          status_sensor_->publish_state(buf);
+                        }
+                      } else {
+                        ESP_LOGW(TAG, "Failed to read valid template count");
+                      }
+                      if (on_done)
+                        on_done(ok);
+                    });
 }
 
 // 握手测试
-bool ZW101Component::handshake() {
-  uint8_t packet[12];
-  uint16_t length = 3;
-  uint16_t checksum = 1 + length + CMD_HANDSHAKE;
-
-  build_packet_header(packet, length);
-  packet[9] = CMD_HANDSHAKE;
-  packet[10] = (checksum >> 8) & 0xFF;
-  packet[11] = checksum & 0xFF;
-
-  write_array(packet, 12);
-  flush();
-
-  uint8_t response[32];
-  uint8_t resp_len = wait_for_response(response, 32, 500);
-
-  if (resp_len >= 12 && response[9] == 0x00) {
-    ESP_LOGI(TAG, "Handshake successful");
-    if (status_sensor_) {
-      status_sensor_->publish_state("Module Online");
+bool ZW101Component::handshake(ResultCallback on_done) {
+  return send_frame(FRAME_HANDSHAKE, 500, [this, on_done](uint8_t code, const uint8_t *, uint16_t) {
+    bool ok = code == ACK_SUCCESS;
+    if (ok) {
+      ESP_LOGI(TAG, "Handshake successful");
+      if (status_sensor_) {
+        status_sensor_->publish_state("Module Online");
+      }
+    } else {
+      ESP_LOGW(TAG, "Handshake failed");
+      if (status_sensor_) {
+        status_sensor_->publish_state("Module Offline");
+      }
     }
-    return true;
-  }
+    if (on_done)
+      on_done(ok);
+  });
+}
 
-  ESP_LOGW(TAG, "Handshake failed");
-  if (status_sensor_) {
-    status_sensor_->publish_state("Module Offline");
+// 改写模组地址: 指令发往当前地址, 模组用新地址应答, 之后的指令都使用新地址
+bool ZW101Component::set_module_address(uint32_t address, ResultCallback on_done) {
+  auto frame = FRAME_SET_CHIP_ADDR;
+  frame.set_u16(10, address >> 16);
+  frame.set_u16(12, address & 0xFFFF);
+
+  bool queued = send_frame(frame, COMMON_TIMEOUT, [this, address, on_done](uint8_t code, const uint8_t *, uint16_t) {
+    address_changing_ = false;
+    bool ok = code == ACK_SUCCESS;
+    if (ok) {
+      ESP_LOGI(TAG, "Module address changed 0x%08X -> 0x%08X", (unsigned) address_, (unsigned) address);
+      address_ = address;
+    } else {
+      ESP_LOGW(TAG, "Failed to change module address (code 0x%02X)", code);
+    }
+    if (on_done)
+      on_done(ok);
+  });
+  if (queued) {
+    new_address_ = address;
+    address_changing_ = true;
   }
-  return false;
+  return queued;
 }
 
 // 删除指定指纹
-bool ZW101Component::delete_fingerprint(uint16_t id) {
-  uint8_t packet[16];
-  uint16_t length = 7;
-  uint16_t delete_count = 1;  // 删除1个指纹
-  uint16_t checksum = 1 + length + CMD_DEL_CHAR +
-                      (id >> 8) + (id & 0xFF) +
-                      (delete_count >> 8) + (delete_count & 0xFF);
-
-  build_packet_header(packet, length);
-  packet[9] = CMD_DEL_CHAR;
-  packet[10] = (id >> 8) & 0xFF;
-  packet[11] = id & 0xFF;
-  packet[12] = (delete_count >> 8) & 0xFF;
-  packet[13] = delete_count & 0xFF;
-  packet[14] = (checksum >> 8) & 0xFF;
-  packet[15] = checksum & 0xFF;
-
-  write_array(packet, 16);
-  flush();
-
-  uint8_t response[32];
-  uint8_t resp_len = wait_for_response(response, 32, 1000);
-
-  if (resp_len >= 12 && response[9] == 0x00) {
-    ESP_LOGI(TAG, "Fingerprint ID %d deleted successfully", id);
-    if (status_sensor_) {
+bool ZW101Component::delete_fingerprint(uint16_t id, ResultCallback on_done) { return delete_range(id, 1, on_done); }
+
+// 删除连续的 ID [start, start + count); 其中有重排过的 ID 时换算成页, 合并为区间逐条删除
+bool ZW101Component::delete_range(uint16_t start, uint16_t count, ResultCallback on_done) {
+  if (relocation_blocks())
+    return false;
+  // ID 经 remap_ 换算前先检查范围, 否则超出容量的 ID 换算后为空, 什么都不删也会报告成功
+  if (count == 0 || start >= library_capacity_ || count > library_capacity_ - start) {
+    ESP_LOGW(TAG, "Delete range %d+%d out of range (capacity %d)", start, count, library_capacity_);
+    return false;
+  }
+  ResultCallback done = [this, start, count, on_done](bool ok) {
+    if (ok) {
       char buf[64];
-      snprintf(buf, sizeof(buf), "Deleted ID: %d", id);
-      status_sensor_->publish_state(buf);
+      if (count == 1) {
+        snprintf(buf, sizeof(buf), "Deleted ID: %d", start);
+      } else {
+        snprintf(buf, sizeof(buf), "Deleted IDs: %d-%d", start, start + count - 1);
+      }
+      ESP_LOGI(TAG, "%s", buf);
+      if (status_sensor_)
+        status_sensor_->publish_state(buf);
     }
-    return true;
-  }
+    if (on_done)
+      on_done(ok);
+  };
+  if (remap_.is_identity(start, count))
+    return delete_pages(start, count, std::move(done));
+
+  std::vector<uint16_t> pages;
+  for (uint32_t id = start; id < (uint32_t) start + count && id < library_capacity_; id++)
+    pages.push_back(remap_.page_of(id));
+  std::sort(pages.begin(), pages.end());
+  auto ranges = std::make_shared<std::vector<TemplateIndex::PageRange>>(template_index_.merge_deletions(pages));
+  return delete_next_range(ranges, 0, std::move(done));
+}
 
-  ESP_LOGW(TAG, "Failed to delete fingerprint ID %d", id);
-  return false;
+// 删除连续的页 [start, start + count)
+bool ZW101Component::delete_pages(uint16_t start, uint16_t count, ResultCallback on_done) {
+  auto frame = FRAME_DEL_CHAR;
+  frame.set_u16(10, start).set_u16(12, count);
+
+  uint16_t timeout = count > 1 ? EMPTY_TIMEOUT : COMMON_TIMEOUT;
+  return send_frame(frame, timeout, [this, start, count, on_done](uint8_t code, const uint8_t *, uint16_t) {
+    bool ok = code == ACK_SUCCESS;
+    if (ok) {
+      for (uint16_t page = start; page < start + count; page++) {
+        template_index_.set_used(page, false);
+        candidates_.remove(page);
+      }
+      if (loaded_candidate_ >= start && loaded_candidate_ - start < count)
+        loaded_candidate_ = NO_PAGE;
+      ESP_LOGD(TAG, "Deleted pages %d-%d", start, start + count - 1);
+    } else {
+      ESP_LOGW(TAG, "Failed to delete pages %d-%d (code 0x%02X)", start, start + count - 1, code);
+    }
+    if (on_done)
+      on_done(ok);
+  });
 }
 
-// RGB LED 控制
+// RGB LED 控制: 只记录目标状态, 由 loop 在指令间隙发出; 连续多次调用只发最后一次
 void ZW101Component::set_rgb_led(uint8_t mode, uint8_t color, uint8_t brightness) {
-  uint8_t packet[18];  // 总共18字节: 头(9) + 命令参数(6) + 校验和(2)
-  uint16_t length = 8;  // 包长度字段: 8字节 (命令码到保留字节,不含校验和)
-
-  // RGB 控制参数 (与原始C代码一致)
-  uint8_t func_code = mode;      // 功能码: 1=呼吸 2=闪烁 3=常亮 4=关闭 5=渐变开 6=渐变关 7=跑马灯
-  uint8_t start_color = color;   // 起始颜色: 1=蓝 2=绿 3=青 4=红 5=紫 6=黄 7=白
-  uint8_t end_color_duty = brightness;  // 结束颜色/占空比: 0-255
-  uint8_t loop_times = 0;        // 循环次数(0=无限)
-  uint8_t cycle = 0x0f;          // 周期 (0x0f = 15, 单位:100ms)
-
-  // 计算校验和: 从包标识开始到保留字节
-  uint16_t checksum = 1 + length + CMD_RGB_CTRL +
-                      func_code + start_color + end_color_duty + loop_times + cycle + 0x00;
-
-  build_packet_header(packet, length);
-  packet[9] = CMD_RGB_CTRL;
-  packet[10] = func_code;
-  packet[11] = start_color;
-  packet[12] = end_color_duty;
-  packet[13] = loop_times;
-  packet[14] = cycle;
-  packet[15] = 0x00;  // 保留字节
-  packet[16] = (checksum >> 8) & 0xFF;
-  packet[17] = checksum & 0xFF;
-
-  write_array(packet, 18);  // 发送18字节
-  flush();
+  if (led_pending_)
+    led_commands_skipped_++;  // 上一次请求还没发出, 被本次覆盖
+  led_requested_ = {mode, color, brightness};
+  led_pending_ = true;
+}
 
-  ESP_LOGI(TAG, "RGB LED set - Mode: %d, Color: %d, Brightness: %d", mode, color, brightness);
+// 发出挂起的灯控请求: 队列空闲时才发送, 不插在采图、搜索等交互之间; 应答由回调消费
+void ZW101Component::flush_led() {
+  if (!led_pending_ || led_in_flight_ || queue_count_ > 0)
+    return;
+  // 休眠期间缓存, 唤醒后再发 (灯控指令本身不唤醒模组)
+  if (power_state_ != POWER_AWAKE)
+    return;
+  // 自动模式指令执行期间模组只接受取消指令
+  if (auto_mode_ != AUTO_MODE_NONE && !rearm_after_lift_)
+    return;
+  send_led_request();
 }
 
-// 进入休眠模式
-bool ZW101Component::enter_sleep_mode() {
-  uint8_t packet[12];
-  uint16_t length = 3;
-  uint16_t checksum = 1 + length + CMD_INTO_SLEEP;
+// 把挂起的灯控请求排入队列; 进入自动模式前也直接调用, 灯控排在自动指令之前
+void ZW101Component::send_led_request() {
+  led_pending_ = false;
+  LedState state = led_requested_;
+  if (led_applied_known_ && state == led_applied_) {
+    led_commands_skipped_++;
+    ESP_LOGV(TAG, "RGB LED already in requested state");
+    return;
+  }
 
-  build_packet_header(packet, length);
-  packet[9] = CMD_INTO_SLEEP;
-  packet[10] = (checksum >> 8) & 0xFF;
-  packet[11] = checksum & 0xFF;
+  // RGB 控制参数 (与原始C代码一致), 循环次数0=无限, 周期与保留字节取模板值
+  auto frame = FRAME_RGB_CTRL;
+  frame.set_u8(10, state.mode)         // 功能码: 1=呼吸 2=闪烁 3=常亮 4=关闭 5=渐变开 6=渐变关 7=跑马灯
+      .set_u8(11, state.color)         // 起始颜色: 1=蓝 2=绿 3=青 4=红 5=紫 6=黄 7=白
+      .set_u8(12, state.brightness);   // 结束颜色/占空比: 0-255
+
+  if (!send_frame(frame, RGB_TIMEOUT, [this, state](uint8_t code, const uint8_t *, uint16_t) {
+        led_in_flight_ = false;
+        if (code != ACK_SUCCESS) {
+          led_applied_known_ = false;
+          ESP_LOGW(TAG, "RGB LED command failed (0x%02X)", code);
+        } else if (auto_mode_ != AUTO_MODE_NONE) {
+          led_applied_known_ = false;  // 已进入自动模式, 模组随后可能自行改灯
+        } else {
+          led_applied_known_ = true;
+          led_applied_ = state;
+        }
+      })) {
+    led_pending_ = true;
+    return;
+  }
+  led_in_flight_ = true;
+  ESP_LOGI(TAG, "RGB LED set - Mode: %d, Color: %d, Brightness: %d", state.mode, state.color, state.brightness);
+}
 
-  ESP_LOGI(TAG, "Sending sleep command...");
-  ESP_LOG_BUFFER_HEX(TAG, packet, 12);
+// ==================== 电源管理 ====================
 
-  write_array(packet, 12);
-  flush();
+// 进入休眠模式: 取消自动模式, 等队列中的指令 (包括搜索链) 完成后再发休眠指令;
+// 结果通过 on_done 返回。注册或模板传输进行中时拒绝
+bool ZW101Component::enter_sleep_mode(ResultCallback on_done) {
+  if (power_state_ != POWER_AWAKE) {
+    ESP_LOGW(TAG, "Sleep already requested");
+    return false;
+  }
+  if (enroll_state_ != ENROLL_IDLE || transfer_active_) {
+    ESP_LOGW(TAG, "Busy, refusing to enter sleep mode");
+    return false;
+  }
+  if (auto_mode_ != AUTO_MODE_NONE)
+    cancel_auto_mode();
 
-  uint8_t response[32];
-  uint8_t resp_len = wait_for_response(response, 32, 400);
+  ESP_LOGI(TAG, "Entering sleep mode");
+  power_state_ = POWER_DRAINING;
+  sleep_retries_ = 0;
+  sleep_done_ = std::move(on_done);
+  return true;
+}
 
-  ESP_LOGI(TAG, "Sleep response length: %d", resp_len);
-  if (resp_len > 0) {
-    ESP_LOG_BUFFER_HEX(TAG, response, resp_len);
+// 唤醒: 模组由手指触摸上电, 这里只确认它已能应答; 未休眠时直接返回成功
+bool ZW101Component::wake_up(ResultCallback on_done) {
+  if (power_state_ == POWER_AWAKE) {
+    if (on_done)
+      on_done(true);
+    return true;
   }
+  if (power_state_ != POWER_ASLEEP) {
+    ESP_LOGW(TAG, "Sleep transition in progress, cannot wake now");
+    return false;
+  }
+  wake_done_ = std::move(on_done);
+  start_wake();
+  return true;
+}
+
+// 自动休眠条件: 没有任何流程在进行, 且距离上一条指令和上一次搜索活动都超过 sleep_timeout
+bool ZW101Component::idle_for_sleep(uint32_t now) const {
+  if (sleep_timeout_ms_ == 0 || touch_pin_ == nullptr || !search_enabled_)
+    return false;
+  if (queue_count_ > 0 || led_pending_ || transfer_active_ || enroll_state_ != ENROLL_IDLE || relocating_ ||
+      auto_mode_ != AUTO_MODE_NONE || search_state_ != SEARCH_IDLE || touch_triggered_)
+    return false;
+  return now - command_sent_time_ > sleep_timeout_ms_ && now - last_activity_ > sleep_timeout_ms_;
+}
 
-  if (resp_len >= 12 && response[9] == 0x00) {
-    sleep_mode_ = true;
+// 电源状态推进, 非 POWER_AWAKE 时每次 loop 调用
+void ZW101Component::process_power() {
+  uint32_t now = millis();
+
+  switch (power_state_) {
+    case POWER_AWAKE:
+      break;
+
+    case POWER_DRAINING:
+      // 搜索链在应答回调中接续, 队列为空时整条链已经结束
+      if (queue_count_ == 0 && search_state_ != SEARCH_WAIT_REPLY)
+        send_sleep_command();
+      break;
+
+    case POWER_SLEEPING:
+      if (sleep_retry_at_ != 0 && (int32_t) (now - sleep_retry_at_) >= 0)
+        send_sleep_command();
+      break;
+
+    case POWER_ASLEEP:
+      // 触摸中断保留给唤醒后的搜索处理
+      if (touch_triggered_ || queue_count_ > 0)
+        start_wake();
+      break;
+
+    case POWER_WAKING:
+      if (wake_probe_queued_)
+        break;
+      if (now - wake_started_ > WAKE_TIMEOUT_MS) {
+        finish_wake(false);
+        break;
+      }
+      start_wake();
+      break;
+  }
+}
+
+void ZW101Component::send_sleep_command() {
+  power_state_ = POWER_SLEEPING;
+  sleep_retry_at_ = 0;
+  if (!send_frame(FRAME_INTO_SLEEP, SLEEP_TIMEOUT,
+                  [this](uint8_t code, const uint8_t *, uint16_t) { handle_sleep_reply(code); }))
+    sleep_retry_at_ = millis() + SLEEP_RETRY_DELAY_MS;
+}
+
+// 休眠指令应答: 模组忙 (0x01)、休眠失败 (0x12) 或超时时稍后重试
+void ZW101Component::handle_sleep_reply(uint8_t code) {
+  bool ok = code == ACK_SUCCESS;
+  if (ok) {
+    power_state_ = POWER_ASLEEP;
+    sleep_started_ = millis();
     ESP_LOGI(TAG, "Module entered sleep mode");
-    if (status_sensor_) {
+    if (status_sensor_)
       status_sensor_->publish_state("Sleep Mode");
-    }
-    return true;
+  } else if ((code == ACK_COMM_ERR || code == ACK_SLEEP_ERR || code == ACK_TIMEOUT) &&
+             sleep_retries_ < SLEEP_MAX_RETRIES) {
+    sleep_retries_++;
+    ESP_LOGD(TAG, "Sleep command failed (0x%02X), retry %u", code, sleep_retries_);
+    sleep_retry_at_ = millis() + SLEEP_RETRY_DELAY_MS;
+    return;
+  } else {
+    power_state_ = POWER_AWAKE;
+    ESP_LOGW(TAG, "Failed to enter sleep mode - Error code: 0x%02X", code);
   }
 
-  if (resp_len > 0 && resp_len >= 10) {
-    ESP_LOGW(TAG, "Failed to enter sleep mode - Error code: 0x%02X", response[9]);
+  if (sleep_done_) {
+    ResultCallback done = std::move(sleep_done_);
+    sleep_done_ = nullptr;
+    done(ok);
+  }
+}
+
+// 发一次唤醒握手, 插到队列中等待的指令之前
+void ZW101Component::start_wake() {
+  if (power_state_ == POWER_ASLEEP) {
+    power_state_ = POWER_WAKING;
+    wake_started_ = millis();
+    ESP_LOGD(TAG, "Waking module");
+  }
+  wake_probe_queued_ = true;
+  if (!enqueue_front(FRAME_HANDSHAKE.data, FRAME_HANDSHAKE.SIZE, WAKE_PROBE_TIMEOUT,
+                     [this](uint8_t code, const uint8_t *, uint16_t) {
+                       wake_probe_queued_ = false;
+                       if (code == ACK_SUCCESS && power_state_ == POWER_WAKING)
+                         finish_wake(true);
+                     }))
+    wake_probe_queued_ = false;
+}
+
+void ZW101Component::finish_wake(bool ok) {
+  uint32_t now = millis();
+  // 唤醒握手的超时是预期的, 不计入波特率重新探测
+  consecutive_timeouts_ = 0;
+
+  if (ok) {
+    power_state_ = POWER_AWAKE;
+    last_wake_latency_ = now - wake_started_;
+    total_sleep_ms_ += wake_started_ - sleep_started_;
+    ESP_LOGI(TAG, "Module awake after %u ms (slept %.1f s)", (unsigned) last_wake_latency_,
+             (wake_started_ - sleep_started_) / 1000.0f);
+    // 重新上电后模组的灯光状态和缓冲区内容未知
+    led_applied_known_ = false;
+    loaded_candidate_ = NO_PAGE;
+    if (wake_latency_sensor_)
+      wake_latency_sensor_->publish_state(last_wake_latency_);
+    if (sleep_time_sensor_)
+      sleep_time_sensor_->publish_state(total_sleep_ms_ / 1000.0f);
   } else {
-    ESP_LOGW(TAG, "Failed to enter sleep mode - No response or timeout");
+    // 模组没有上电 (没有手指按压): 保持休眠, 排队的指令无法执行
+    power_state_ = POWER_ASLEEP;
+    touch_triggered_ = false;
+    ESP_LOGW(TAG, "Module did not answer within %u ms, still asleep", (unsigned) WAKE_TIMEOUT_MS);
+    abort_queued_commands();
+  }
+
+  if (wake_done_) {
+    ResultCallback done = std::move(wake_done_);
+    wake_done_ = nullptr;
+    done(ok);
+  }
+}
+
+// 以 ACK_ABORTED 完成队列中尚未发出的指令; 回调中新入队的指令不受影响
+void ZW101Component::abort_queued_commands() {
+  for (uint8_t count = command_in_flight_ ? 0 : queue_count_; count > 0 && queue_count_ > 0; count--) {
+    ReplyCallback callback = std::move(command_queue_[queue_head_].callback);
+    command_queue_[queue_head_].callback = nullptr;
+    queue_head_ = (queue_head_ + 1) % COMMAND_QUEUE_SIZE;
+    queue_count_--;
+    if (callback)
+      callback(ACK_ABORTED, nullptr, 0);
   }
-  return false;
 }
 
 // 自动注册模式
 bool ZW101Component::auto_enroll_mode(uint16_t timeout_sec) {
-  if (auto_mode_active_) {
+  if (auto_mode_ != AUTO_MODE_NONE) {
     ESP_LOGW(TAG, "Auto mode already active");
     return false;
   }
+  if (relocation_blocks())
+    return false;
+  loaded_candidate_ = NO_PAGE;
 
-  uint8_t packet[15];
-  uint16_t length = 6;
-  uint16_t timeout_ms = timeout_sec * 1000;
-  uint16_t checksum = 1 + length + CMD_AUTO_ENROLL +
-                      (timeout_ms >> 8) + (timeout_ms & 0xFF);
+  // 与手动注册一样存入第一个空闲页; 超时由主机计时, 模组指令中没有超时参数
+  if (!template_index_.is_loaded()) {
+    ESP_LOGW(TAG, "Index table not available, refusing auto enroll");
+    read_index_table();
+    return false;
+  }
+  int free_page = template_index_.find_free();
+  if (free_page < 0) {
+    ESP_LOGW(TAG, "Fingerprint library full");
+    if (status_sensor_)
+      status_sensor_->publish_state("Enroll Failed - Library Full");
+    return false;
+  }
+
+  auto frame = FRAME_AUTO_ENROLL;
+  frame.set_u16(10, free_page);
 
-  build_packet_header(packet, length);
-  packet[9] = CMD_AUTO_ENROLL;
-  packet[10] = (timeout_ms >> 8) & 0xFF;
-  packet[11] = timeout_ms & 0xFF;
-  packet[12] = 0x00;  // 保留字节
-  packet[13] = (checksum >> 8) & 0xFF;
-  packet[14] = checksum & 0xFF;
+  // 自动指令执行期间模组不接受灯控, 之前请求的灯光先发出
+  if (led_pending_)
+    send_led_request();
 
-  write_array(packet, 15);
-  flush();
+  // 第一条(合法性)应答和后续阶段应答都交给 handle_auto_enroll_reply
+  if (!send_frame(frame, COMMON_TIMEOUT, [this](uint8_t code, const uint8_t *frame, uint16_t length) {
+        handle_auto_enroll_reply(code, frame, length);
+      }))
+    return false;
+  led_applied_known_ = false;  // 自动指令执行期间模组可能自行控制灯光
 
-  auto_mode_active_ = true;
+  auto_mode_ = AUTO_MODE_ENROLL;
+  auto_enroll_page_ = free_page;
   auto_mode_timeout_ = millis() + (timeout_sec * 1000);
 
   ESP_LOGI(TAG, "Auto enroll mode activated, timeout: %d seconds", timeout_sec);
@@ -572,40 +1225,23 @@ bool ZW101Component::auto_enroll_mode(uint16_t timeout_sec) {
   return true;
 }
 
-// 自动匹配模式
+// 自动匹配模式: 采图、提取特征和搜索都由模组完成, 主机只消费阶段应答,
+// 每次出结果后自动重新启动, 直到 cancel_auto_mode()
 bool ZW101Component::auto_match_mode() {
-  if (auto_mode_active_) {
+  if (auto_mode_ != AUTO_MODE_NONE) {
     ESP_LOGW(TAG, "Auto mode already active");
     return false;
   }
+  if (relocation_blocks())
+    return false;
 
-  uint8_t packet[17];
-  uint16_t length = 8;
-  uint8_t buffer_id = 2;
-  uint16_t start_page = 0;
-  uint16_t page_num = library_capacity_;
-  uint8_t security_level = 2;  // 安全等级
-
-  uint16_t checksum = 1 + length + CMD_AUTO_MATCH + buffer_id +
-                      (start_page >> 8) + (start_page & 0xFF) +
-                      (page_num >> 8) + (page_num & 0xFF) +
-                      security_level;
-
-  build_packet_header(packet, length);
-  packet[9] = CMD_AUTO_MATCH;
-  packet[10] = buffer_id;
-  packet[11] = (start_page >> 8) & 0xFF;
-  packet[12] = start_page & 0xFF;
-  packet[13] = (page_num >> 8) & 0xFF;
-  packet[14] = page_num & 0xFF;
-  packet[15] = security_level;
-  packet[16] = (checksum >> 8) & 0xFF;
-  packet[17] = checksum & 0xFF;
-
-  write_array(packet, 17);
-  flush();
+  // 自动指令执行期间模组不接受灯控, 之前请求的灯光先发出
+  if (led_pending_)
+    send_led_request();
+  if (!arm_auto_match())
+    return false;
 
-  auto_mode_active_ = true;
+  auto_mode_ = AUTO_MODE_MATCH;
   auto_mode_timeout_ = 0;  // 无超时
 
   ESP_LOGI(TAG, "Auto match mode activated");
@@ -616,25 +1252,177 @@ bool ZW101Component::auto_match_mode() {
   return true;
 }
 
-// 取消自动模式
-void ZW101Component::cancel_auto_mode() {
-  if (!auto_mode_active_) {
+// 处理自动注册的阶段应答
+void ZW101Component::handle_auto_enroll_reply(uint8_t code, const uint8_t *frame, uint16_t length) {
+  if (auto_mode_ != AUTO_MODE_ENROLL)
+    return;  // 已取消, 迟到的应答直接丢弃
+
+  if (code == ACK_TIMEOUT || length < AUTO_ENROLL_REPLY_SIZE) {
+    ESP_LOGW(TAG, "Auto enroll did not start (0x%02X)", code);
+    finish_auto_enroll("Enroll Failed");
+    return;
+  }
+
+  uint8_t stage = frame[10];
+  uint8_t step = frame[11];
+  char buf[64];
+
+  if (code != ACK_SUCCESS) {
+    switch (stage) {
+      case AUTO_STAGE_GET_IMAGE:
+      case AUTO_STAGE_GEN_CHAR:
+        if (code == ACK_ENROLL_TIMEOUT) {
+          finish_auto_enroll("Enroll Timeout");
+          return;
+        }
+        // 单次采集质量不佳, 模组会继续等待下一次按压
+        ESP_LOGD(TAG, "Auto enroll: sample %d rejected (0x%02X)", step, code);
+        if (status_sensor_) {
+          snprintf(buf, sizeof(buf), "Enrolling %d/%d - Retry", step, AUTO_ENROLL_SAMPLES);
+          status_sensor_->publish_state(buf);
+        }
+        return;
+      case AUTO_STAGE_FINGER_LEAVE:
+        finish_auto_enroll(code == ACK_ENROLL_TIMEOUT ? "Enroll Timeout" : "Enroll Failed");
+        return;
+      case AUTO_STAGE_MERGE:
+        finish_auto_enroll("Enroll Failed - Merge");
+        return;
+      case AUTO_STAGE_DUPLICATE:
+        finish_auto_enroll(code == ACK_FP_DUPLICATION ? "Enroll Failed - Duplicate" : "Enroll Failed");
+        return;
+      case AUTO_STAGE_STORE:
+        finish_auto_enroll("Enroll Failed - Store");
+        return;
+      default:
+        ESP_LOGW(TAG, "Auto enroll rejected at stage 0x%02X: 0x%02X", stage, code);
+        finish_auto_enroll("Enroll Failed");
+        return;
+    }
+  }
+
+  switch (stage) {
+    case AUTO_STAGE_GEN_CHAR:
+      ESP_LOGI(TAG, "Auto enroll: sample %d/%d captured", step, AUTO_ENROLL_SAMPLES);
+      if (status_sensor_) {
+        snprintf(buf, sizeof(buf), "Enrolling %d/%d", step, AUTO_ENROLL_SAMPLES);
+        status_sensor_->publish_state(buf);
+      }
+      break;
+
+    case AUTO_STAGE_FINGER_LEAVE:
+      ESP_LOGD(TAG, "Auto enroll: finger lifted");
+      break;
+
+    case AUTO_STAGE_STORE: {
+      template_index_.set_used(auto_enroll_page_, true);
+      uint16_t id = remap_.id_of(auto_enroll_page_);
+      ESP_LOGI(TAG, "Fingerprint enrolled successfully as ID %d", id);
+      snprintf(buf, sizeof(buf), "Enroll Success (ID: %d)", id);
+      finish_auto_enroll(buf);
+      break;
+    }
+
+    default:
+      ESP_LOGD(TAG, "Auto enroll: stage 0x%02X step 0x%02X", stage, step);
+      break;
+  }
+}
+
+void ZW101Component::finish_auto_enroll(const char *status) {
+  auto_mode_ = AUTO_MODE_NONE;
+  auto_mode_timeout_ = 0;
+  if (status_sensor_)
+    status_sensor_->publish_state(status);
+}
+
+// 发出一次自动验证指令, 第一条(合法性)应答也交给阶段处理
+bool ZW101Component::arm_auto_match() {
+  loaded_candidate_ = NO_PAGE;  // 自动模式由模组使用特征缓冲区
+  // 自动验证只能指定一个区间, 取覆盖全部已占用页的最小区间
+  TemplateIndex::PageRange range;
+  if (plan_search_ranges(&range, 1) == 0)
+    range = {0, library_capacity_};
+  auto frame = FRAME_AUTO_MATCH;
+  frame.set_u16(11, range.start).set_u16(13, range.count);
+
+  led_applied_known_ = false;  // 自动指令执行期间模组可能自行控制灯光
+  return send_frame(frame, COMMON_TIMEOUT, [this](uint8_t code, const uint8_t *frame, uint16_t length) {
+    handle_auto_match_reply(code, frame, length);
+  });
+}
+
+// 处理自动验证的阶段应答
+void ZW101Component::handle_auto_match_reply(uint8_t code, const uint8_t *frame, uint16_t length) {
+  if (auto_mode_ != AUTO_MODE_MATCH)
+    return;  // 已取消, 迟到的应答直接丢弃
+
+  if (code == ACK_TIMEOUT || length < AUTO_MATCH_REPLY_SIZE) {
+    ESP_LOGW(TAG, "Auto match did not start (0x%02X), leaving auto mode", code);
+    auto_mode_ = AUTO_MODE_NONE;
+    if (status_sensor_)
+      status_sensor_->publish_state("Auto Match Failed");
     return;
   }
 
-  uint8_t packet[12];
-  uint16_t length = 3;
-  uint16_t checksum = 1 + length + 0x30;  // CMD_AUTO_CANCEL
+  uint8_t stage = frame[10];
+  switch (stage) {
+    case AUTO_STAGE_LEGALITY:
+      if (code != ACK_SUCCESS) {
+        // 参数被模组拒绝, 重新启动也不会成功
+        ESP_LOGW(TAG, "Auto match rejected: 0x%02X", code);
+        auto_mode_ = AUTO_MODE_NONE;
+        if (status_sensor_)
+          status_sensor_->publish_state("Auto Match Failed");
+      }
+      return;
 
-  build_packet_header(packet, length);
-  packet[9] = 0x30;  // CMD_AUTO_CANCEL
-  packet[10] = (checksum >> 8) & 0xFF;
-  packet[11] = checksum & 0xFF;
+    case AUTO_STAGE_GET_IMAGE:
+      if (code == ACK_SUCCESS) {
+        ESP_LOGD(TAG, "Auto match: image captured");
+        return;  // 等待搜索结果
+      }
+      ESP_LOGD(TAG, "Auto match: capture failed (0x%02X)", code);
+      break;
 
-  write_array(packet, 12);
-  flush();
+    case AUTO_STAGE_SEARCH:
+      if (code == ACK_SUCCESS) {
+        publish_match((frame[11] << 8) | frame[12], (frame[13] << 8) | frame[14]);
+      } else {
+        ESP_LOGD(TAG, "Auto match: no match (0x%02X)", code);
+        if (status_sensor_)
+          status_sensor_->publish_state("No Match");
+      }
+      // 等手指离开后再重新启动, 否则按着不动会反复验证
+      rearm_after_lift_ = true;
+      wait_for_lift();
+      return;
 
-  auto_mode_active_ = false;
+    default:
+      ESP_LOGD(TAG, "Auto match: stage 0x%02X, code 0x%02X", stage, code);
+      if (code == ACK_SUCCESS)
+        return;
+      break;
+  }
+
+  // 采图失败等: 本次验证结束, 模组回到空闲, 立即重新启动
+  if (!arm_auto_match()) {
+    ESP_LOGW(TAG, "Failed to re-arm auto match, leaving auto mode");
+    auto_mode_ = AUTO_MODE_NONE;
+  }
+}
+
+// 取消自动模式
+void ZW101Component::cancel_auto_mode() {
+  if (auto_mode_ == AUTO_MODE_NONE) {
+    return;
+  }
+
+  // 插到被挡住的指令之前, 模组退出自动模式后它们才能得到正常应答
+  if (!enqueue_front(FRAME_AUTO_CANCEL.data, FRAME_AUTO_CANCEL.SIZE, COMMON_TIMEOUT, nullptr))
+    send_frame(FRAME_AUTO_CANCEL, COMMON_TIMEOUT, nullptr);
+
+  auto_mode_ = AUTO_MODE_NONE;
   auto_mode_timeout_ = 0;
 
   ESP_LOGI(TAG, "Auto mode cancelled");
@@ -643,124 +1431,945 @@ void ZW101Component::cancel_auto_mode() {
   }
 }
 
-// ==================== 私有方法 ====================
+// 上传模板: 读出到特征缓冲区后上传, 数据包逐个交给 sink; page 为模板 ID
+bool ZW101Component::upload_template(uint16_t page, DataSink sink, ResultCallback on_done) {
+  if (relocation_blocks())
+    return false;
+  if (transfer_active_ || enroll_state_ != ENROLL_IDLE || auto_mode_ != AUTO_MODE_NONE) {
+    ESP_LOGW(TAG, "Template transfer refused, module busy");
+    return false;
+  }
+  if (page >= library_capacity_) {
+    ESP_LOGW(TAG, "Template page %d out of range", page);
+    return false;
+  }
+
+  auto frame = FRAME_LOAD_CHAR;
+  frame.set_u8(10, TRANSFER_BUFFER).set_u16(11, remap_.page_of(page));
+  data_sink_ = std::move(sink);
+  transfer_active_ = true;
+  loaded_candidate_ = NO_PAGE;
+
+  bool queued = send_frame(frame, COMMON_TIMEOUT, [this, page, on_done](uint8_t code, const uint8_t *, uint16_t) {
+    if (code != ACK_SUCCESS) {
+      ESP_LOGW(TAG, "Load template %d failed: 0x%02X", page, code);
+      finish_transfer(false, on_done);
+      return;
+    }
+
+    auto up = FRAME_UP_CHAR;
+    up.set_u8(10, TRANSFER_BUFFER);
+    bool queued = send_frame(
+        up, DATA_PACKET_TIMEOUT,
+        [this, page, on_done](uint8_t code, const uint8_t *, uint16_t) {
+          if (code == ACK_SUCCESS) {
+            ESP_LOGI(TAG, "Template %d uploaded", page);
+          } else {
+            ESP_LOGW(TAG, "Upload template %d failed: 0x%02X", page, code);
+          }
+          finish_transfer(code == ACK_SUCCESS, on_done);
+        },
+        DATA_RECEIVE);
+    if (!queued)
+      finish_transfer(false, on_done);
+  });
+
+  if (!queued) {
+    transfer_active_ = false;
+    data_sink_ = nullptr;
+  }
+  return queued;
+}
 
-// 发送简单命令
-void ZW101Component::send_cmd(uint8_t cmd) {
-  uint8_t packet[12];
-  uint16_t length = 3;
-  uint16_t checksum = 1 + length + cmd;
+// 下载模板: 按数据包大小从 source 取数据发给模组, 完成后存入 ID page 所在的页
+bool ZW101Component::download_template(uint16_t page, uint32_t size, DataSource source, ResultCallback on_done) {
+  if (relocation_blocks())
+    return false;
+  if (transfer_active_ || enroll_state_ != ENROLL_IDLE || auto_mode_ != AUTO_MODE_NONE) {
+    ESP_LOGW(TAG, "Template transfer refused, module busy");
+    return false;
+  }
+  if (page >= library_capacity_ || size == 0) {
+    ESP_LOGW(TAG, "Invalid template download (page %d, %u bytes)", page, (unsigned) size);
+    return false;
+  }
 
-  build_packet_header(packet, length);
-  packet[9] = cmd;
-  packet[10] = (checksum >> 8) & 0xFF;
-  packet[11] = checksum & 0xFF;
+  auto frame = FRAME_DOWN_CHAR;
+  frame.set_u8(10, TRANSFER_BUFFER);
+  data_source_ = std::move(source);
+  data_remaining_ = size;
+  transfer_active_ = true;
+  loaded_candidate_ = NO_PAGE;
+
+  bool queued = send_frame(
+      frame, DATA_PACKET_TIMEOUT,
+      [this, page, on_done](uint8_t code, const uint8_t *, uint16_t) {
+        if (code != ACK_SUCCESS) {
+          ESP_LOGW(TAG, "Download template %d failed: 0x%02X", page, code);
+          finish_transfer(false, on_done);
+          return;
+        }
 
-  write_array(packet, 12);
-  flush();
+        uint16_t slot = remap_.page_of(page);
+        bool queued = send_store_cmd(TRANSFER_BUFFER, slot, [this, page, slot, on_done](uint8_t code, const uint8_t *,
+                                                                                        uint16_t) {
+          if (code == ACK_SUCCESS) {
+            template_index_.set_used(slot, true);
+            candidates_.remove(slot);
+            ESP_LOGI(TAG, "Template restored to page %d", page);
+          } else {
+            ESP_LOGW(TAG, "Store downloaded template %d failed: 0x%02X", page, code);
+          }
+          finish_transfer(code == ACK_SUCCESS, on_done);
+        });
+        if (!queued)
+          finish_transfer(false, on_done);
+      },
+      DATA_SEND);
+
+  if (!queued) {
+    transfer_active_ = false;
+    data_source_ = nullptr;
+  }
+  return queued;
 }
 
-// 发送带1个参数的命令
-void ZW101Component::send_cmd2(uint8_t cmd, uint8_t param1) {
-  uint8_t packet[13];
-  uint16_t length = 4;
-  uint16_t checksum = 1 + length + cmd + param1;
+// ==================== 批量操作 ====================
 
-  build_packet_header(packet, length);
-  packet[9] = cmd;
-  packet[10] = param1;
-  packet[11] = (checksum >> 8) & 0xFF;
-  packet[12] = checksum & 0xFF;
+// 批量删除: 排序去重、换算成页后合并为区间, 逐条删除
+bool ZW101Component::delete_fingerprints(std::vector<uint16_t> ids, ResultCallback on_done) {
+  if (relocation_blocks())
+    return false;
+  std::sort(ids.begin(), ids.end());
+  ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+  while (!ids.empty() && ids.back() >= library_capacity_) {
+    ESP_LOGW(TAG, "ID %d beyond library capacity, skipped", ids.back());
+    ids.pop_back();
+  }
+  std::vector<uint16_t> pages;
+  for (uint16_t id : ids)
+    pages.push_back(remap_.page_of(id));
+  std::sort(pages.begin(), pages.end());
+
+  auto ranges = std::make_shared<std::vector<TemplateIndex::PageRange>>(template_index_.merge_deletions(pages));
+  ESP_LOGI(TAG, "Deleting %u IDs with %u commands", (unsigned) ids.size(), (unsigned) ranges->size());
+  if (ranges->empty()) {
+    if (on_done)
+      on_done(true);
+    return true;
+  }
+  size_t deleted = ids.size();
+  return delete_next_range(ranges, 0, [this, deleted, on_done](bool ok) {
+    if (ok && status_sensor_) {
+      char buf[64];
+      snprintf(buf, sizeof(buf), "Deleted %u IDs", (unsigned) deleted);
+      status_sensor_->publish_state(buf);
+    }
+    if (on_done)
+      on_done(ok);
+  });
+}
 
-  write_array(packet, 13);
-  flush();
+// 删除第 next 个区间, 完成后继续下一个; 返回是否成功入队
+bool ZW101Component::delete_next_range(std::shared_ptr<std::vector<TemplateIndex::PageRange>> ranges, size_t next,
+                                       ResultCallback on_done) {
+  if (next >= ranges->size()) {
+    if (on_done)
+      on_done(true);
+    return true;
+  }
+  const TemplateIndex::PageRange &range = (*ranges)[next];
+  return delete_pages(range.start, range.count, [this, ranges, next, on_done](bool ok) {
+    if (!(ok && delete_next_range(ranges, next + 1, on_done)) && on_done)
+      on_done(false);
+  });
 }
 
-// 发送存储命令
-void ZW101Component::send_store_cmd(uint8_t buffer_id, uint16_t template_id) {
-  uint8_t packet[15];
-  uint16_t length = 6;
-  uint16_t checksum = 1 + length + CMD_STORE_CHAR + buffer_id + (template_id >> 8) + (template_id & 0xFF);
+// 批量下载: 每页下载并存储完成后再开始下一页
+bool ZW101Component::download_templates(std::vector<uint16_t> pages, uint32_t size, DataSourceFactory open,
+                                        BatchCallback on_done) {
+  if (transfer_active_) {
+    ESP_LOGW(TAG, "Template transfer refused, module busy");
+    return false;
+  }
+  auto list = std::make_shared<std::vector<uint16_t>>(std::move(pages));
+  auto failed = std::make_shared<std::vector<uint16_t>>();
+  return download_next_template(list, 0, size, std::move(open), failed, std::move(on_done));
+}
 
-  build_packet_header(packet, length);
-  packet[9] = CMD_STORE_CHAR;
-  packet[10] = buffer_id;
-  packet[11] = (template_id >> 8) & 0xFF;
-  packet[12] = template_id & 0xFF;
-  packet[13] = (checksum >> 8) & 0xFF;
-  packet[14] = checksum & 0xFF;
+// 下载第 next 页, 完成后继续下一页; 返回是否成功入队
+bool ZW101Component::download_next_template(std::shared_ptr<std::vector<uint16_t>> pages, size_t next, uint32_t size,
+                                            DataSourceFactory open, std::shared_ptr<std::vector<uint16_t>> failed,
+                                            BatchCallback on_done) {
+  if (next >= pages->size()) {
+    ESP_LOGI(TAG, "Batch download finished, %u/%u stored", (unsigned) (pages->size() - failed->size()),
+             (unsigned) pages->size());
+    if (on_done)
+      on_done(failed->empty(), *failed);
+    return true;
+  }
+
+  uint16_t page = (*pages)[next];
+  return download_template(page, size, open(page), [this, pages, next, size, open, failed, on_done](bool ok) {
+    if (!ok)
+      failed->push_back((*pages)[next]);
+    if (!download_next_template(pages, next + 1, size, open, failed, on_done)) {
+      // 无法入队时后续各页同样无法进行
+      failed->insert(failed->end(), pages->begin() + next + 1, pages->end());
+      if (on_done)
+        on_done(false, *failed);
+    }
+  });
+}
+
+// 核对指纹库: 重新读取索引表, 删除多余模板, 报告缺失的 ID
+bool ZW101Component::reconcile_library(std::vector<uint16_t> desired, BatchCallback on_done) {
+  if (relocation_blocks())
+    return false;
+  std::sort(desired.begin(), desired.end());
+  desired.erase(std::unique(desired.begin(), desired.end()), desired.end());
+
+  return read_index_table([this, desired, on_done](bool ok) {
+    if (!ok) {
+      ESP_LOGW(TAG, "Reconcile failed, index table not available");
+      if (on_done)
+        on_done(false, desired);
+      return;
+    }
+
+    std::vector<uint16_t> stored;
+    for (int page = template_index_.next_used(0); page >= 0; page = template_index_.next_used(page + 1))
+      stored.push_back(remap_.id_of(page));
+    std::sort(stored.begin(), stored.end());
+    std::vector<uint16_t> extra;
+    auto wanted = desired.begin();
+    for (uint16_t id : stored) {
+      while (wanted != desired.end() && *wanted < id)
+        wanted++;
+      if (wanted == desired.end() || *wanted != id)
+        extra.push_back(id);
+    }
+    std::vector<uint16_t> missing;
+    for (uint16_t id : desired) {
+      if (id < library_capacity_ && !template_index_.is_used(remap_.page_of(id)))
+        missing.push_back(id);
+    }
+    ESP_LOGI(TAG, "Reconcile: %u extra, %u missing", (unsigned) extra.size(), (unsigned) missing.size());
+
+    bool queued = delete_fingerprints(extra, [on_done, missing](bool ok) {
+      if (on_done)
+        on_done(ok, missing);
+    });
+    if (!queued && on_done)
+      on_done(false, missing);
+  });
+}
+
+// ==================== 指纹库重排 ====================
+
+// 页上模板对外的 ID; 搬移日志未结束时 src 与 dst 上是同一个模板
+uint16_t ZW101Component::template_id(uint16_t page) const {
+  if (remap_.move_state() == PageRemap::MOVE_DELETING && page == remap_.move_src())
+    page = remap_.move_dst();
+  else if (remap_.move_state() == PageRemap::MOVE_COPYING && page == remap_.move_dst())
+    page = remap_.move_src();
+  return remap_.id_of(page);
+}
 
-  write_array(packet, 15);
-  flush();
+// 重排条件: 有新的匹配记录, 没有任何流程在进行, 且距离上一次搜索活动超过 RELOCATE_IDLE_MS
+bool ZW101Component::idle_for_relocation(uint32_t now) const {
+  if (!optimize_library_ || !relocate_pending_ || !template_index_.is_loaded())
+    return false;
+  if (queue_count_ > 0 || led_pending_ || transfer_active_ || enroll_state_ != ENROLL_IDLE ||
+      auto_mode_ != AUTO_MODE_NONE || search_state_ != SEARCH_IDLE || touch_triggered_)
+    return false;
+  return now - last_activity_ > RELOCATE_IDLE_MS;
+}
+
+// 规划一次搬移: 按匹配次数从多到少, 找第一个前面还有空页或更冷模板的常用模板。
+// 前面是空页时直接搬过去; 是更冷的模板时先把它搬到后面的空页, 下一个空闲窗口再搬常用模板。
+// 匹配次数相同的模板互不挤占, 不会来回搬; 没有可做的搬移时返回 false
+bool ZW101Component::plan_relocation(uint16_t *src, uint16_t *dst) {
+  for (uint8_t i = 0; i < candidates_.count(); i++) {
+    uint8_t hits = candidates_.hits(i);
+    if (hits < RELOCATE_MIN_HITS)
+      break;
+    uint16_t hot = candidates_.at(i);
+    if (!template_index_.is_used(hot))
+      continue;
+    // 跳过的只有比它更常用的已记录页, 最多 MAX_TRACKED 个
+    uint16_t target = 0;
+    while (target < hot && template_index_.is_used(target) && candidates_.hits_of(target) >= hits)
+      target++;
+    if (target == hot)
+      continue;
+
+    if (template_index_.is_used(target)) {
+      int free_page = template_index_.next_free(target + 1);
+      if (free_page < 0)
+        return false;  // 库满, 没有腾挪的空间
+      *src = target;
+      *dst = free_page;
+    } else {
+      *src = hot;
+      *dst = target;
+    }
+    if (!remap_.can_swap(*src, *dst)) {
+      ESP_LOGD(TAG, "ID remap table full, library optimization stopped");
+      return false;
+    }
+    return true;
+  }
+  return false;
+}
+
+// 开始搬移: 日志先落盘, 再发出读出指令
+void ZW101Component::start_relocation(uint16_t src, uint16_t dst) {
+  ESP_LOGD(TAG, "Moving template ID %u from page %u to page %u", remap_.id_of(src), src, dst);
+  remap_.begin_move(src, dst);
+  if (!save_remap()) {
+    remap_.end_move();
+    relocate_pending_ = false;
+    return;
+  }
+  relocating_ = true;
+  copy_template();
+}
+
+// 按日志继续搬移: 重启后和出错后由 loop 调用
+void ZW101Component::resume_relocation() {
+  relocate_retry_at_ = 0;
+  switch (remap_.move_state()) {
+    case PageRemap::MOVE_NONE:
+      relocating_ = false;
+      break;
+
+    case PageRemap::MOVE_COPYING:
+      // 复制是否完成以 dst 是否已占用为准, 索引表失效时先重新读取
+      if (!template_index_.is_loaded()) {
+        read_index_table([this](bool ok) {
+          if (ok) {
+            resume_relocation();
+          } else {
+            retry_relocation();
+          }
+        });
+        break;
+      }
+      if (template_index_.is_used(remap_.move_dst())) {
+        finish_copy();
+      } else {
+        abandon_relocation();
+      }
+      break;
+
+    case PageRemap::MOVE_DELETING:
+      delete_moved_source();
+      break;
+  }
+}
+
+// 读出 src 到缓冲区2, 再存入 dst; 任一步失败都按日志重新确认
+void ZW101Component::copy_template() {
+  uint16_t src = remap_.move_src();
+  uint16_t dst = remap_.move_dst();
+  auto load = FRAME_LOAD_CHAR;
+  load.set_u8(10, TRANSFER_BUFFER).set_u16(11, src);
+  loaded_candidate_ = NO_PAGE;
+
+  if (!send_frame(load, COMMON_TIMEOUT, [this, src, dst](uint8_t code, const uint8_t *, uint16_t) {
+        if (code != ACK_SUCCESS) {
+          ESP_LOGW(TAG, "Failed to load page %u for relocation (0x%02X)", src, code);
+          abandon_relocation();
+          return;
+        }
+        if (!send_store_cmd(TRANSFER_BUFFER, dst, [this, dst](uint8_t code, const uint8_t *, uint16_t) {
+              if (code == ACK_SUCCESS) {
+                template_index_.set_used(dst, true);
+                finish_copy();
+                return;
+              }
+              // 超时时模板可能已经写入, 重新读索引表确认
+              ESP_LOGW(TAG, "Failed to store relocated template to page %u (0x%02X)", dst, code);
+              template_index_.invalidate();
+              retry_relocation();
+            }))
+          retry_relocation();
+      }))
+    retry_relocation();
+}
+
+// 副本已写入 dst: 交换两页的 ID 并记录, 之后 dst 上的模板以原来的 ID 发布, 再删除 src
+void ZW101Component::finish_copy() {
+  uint16_t src = remap_.move_src();
+  uint16_t dst = remap_.move_dst();
+  if (!remap_.finish_copy()) {
+    // 映射表在开始前已确认放得下, 只有日志被外部改动时才会走到这里
+    ESP_LOGE(TAG, "Cannot remap page %u to %u, keeping both copies", src, dst);
+    abandon_relocation();
+    return;
+  }
+  candidates_.rename(src, dst);
+  save_remap();  // 写入失败时重启后仍是复制阶段, dst 已占用, 同样走到这里
+  delete_moved_source();
+}
+
+void ZW101Component::delete_moved_source() {
+  uint16_t src = remap_.move_src();
+  uint16_t dst = remap_.move_dst();
+  if (!delete_pages(src, 1, [this, dst](bool ok) {
+        if (!ok) {
+          retry_relocation();
+          return;
+        }
+        // 日志结束后 src 才能再被注册使用
+        remap_.end_move();
+        save_remap();
+        relocating_ = false;
+        relocate_pending_ = true;
+        template_moves_++;
+        ESP_LOGI(TAG, "Template ID %u moved to page %u", remap_.id_of(dst), dst);
+      }))
+    retry_relocation();
+}
+
+// 复制没有完成: 模板仍在 src, 丢弃日志; 等下一次匹配后再重新规划
+void ZW101Component::abandon_relocation() {
+  ESP_LOGW(TAG, "Template move %u -> %u abandoned", remap_.move_src(), remap_.move_dst());
+  remap_.end_move();
+  save_remap();
+  relocating_ = false;
+  relocate_pending_ = false;
+}
+
+void ZW101Component::retry_relocation() { relocate_retry_at_ = millis() + RELOCATE_RETRY_MS; }
+
+// 映射和日志立即写入 flash: 搬移的下一步必须在日志落盘之后
+bool ZW101Component::save_remap() {
+  if (remap_pref_.save(&remap_) && global_preferences->sync())
+    return true;
+  ESP_LOGW(TAG, "Failed to save template ID remap");
+  return false;
+}
+
+// 搬移期间拒绝改动指纹库和占用缓冲区2的操作
+bool ZW101Component::relocation_blocks() const {
+  if (!relocating_)
+    return false;
+  ESP_LOGW(TAG, "Template relocation in progress, try again later");
+  return true;
+}
+
+// ==================== 私有方法 ====================
+
+void ZW101Component::finish_transfer(bool ok, const ResultCallback &on_done) {
+  transfer_active_ = false;
+  data_sink_ = nullptr;
+  data_source_ = nullptr;
+  data_remaining_ = 0;
+  if (on_done)
+    on_done(ok);
+}
+
+// 采图 + 生成特征: 采图成功后在应答回调中直接发出生成特征, 两条指令之间不经过 loop 调度
+// on_done(cmd, code): cmd 为流程结束时的指令 (CMD_GET_IMAGE 或 CMD_GEN_CHAR), 特征生成成功时 code 为 ACK_SUCCESS
+bool ZW101Component::capture_features(bool enroll, uint8_t buffer_id, CaptureCallback on_done) {
+  auto on_image = [this, buffer_id, on_done](uint8_t code, const uint8_t *, uint16_t) {
+    if (code != ACK_SUCCESS) {
+      on_done(CMD_GET_IMAGE, code);
+      return;
+    }
+    if (!send_gen_char_cmd(buffer_id, [on_done](uint8_t code, const uint8_t *, uint16_t) { on_done(CMD_GEN_CHAR, code); }))
+      on_done(CMD_GEN_CHAR, ACK_ABORTED);
+  };
+  if (enroll)
+    return send_frame(FRAME_GET_IMAGE_ENROLL, CAPTURE_TIMEOUT, on_image);
+  return send_frame(FRAME_GET_IMAGE, CAPTURE_TIMEOUT, on_image);
+}
+
+// 发送生成特征命令
+bool ZW101Component::send_gen_char_cmd(uint8_t buffer_id, ReplyCallback callback) {
+  auto frame = FRAME_GEN_CHAR;
+  frame.set_u8(10, buffer_id);
+  return send_frame(frame, COMMON_TIMEOUT, std::move(callback));
+}
+
+// 发送存储命令
+bool ZW101Component::send_store_cmd(uint8_t buffer_id, uint16_t template_id, ReplyCallback callback) {
+  auto frame = FRAME_STORE_CHAR;
+  frame.set_u8(10, buffer_id).set_u16(11, template_id);
+  return send_frame(frame, COMMON_TIMEOUT, std::move(callback));
 }
 
 // 发送搜索命令
-void ZW101Component::send_search_cmd(uint8_t buffer_id, uint16_t start_page, uint16_t page_num) {
-  uint8_t packet[17];
-  uint16_t length = 8;
-
-  build_packet_header(packet, length);
-  packet[9] = CMD_SEARCH;
-  packet[10] = buffer_id;
-  packet[11] = (start_page >> 8) & 0xFF;
-  packet[12] = start_page & 0xFF;
-  packet[13] = (page_num >> 8) & 0xFF;
-  packet[14] = page_num & 0xFF;
-  
-  // 计算校验和: 从packet[6]开始到packet[14] (不含校验和本身)
-  uint16_t checksum = 0;
-  for (int i = 6; i < 15; i++) {
-    checksum += packet[i];
-  }
-  
-  packet[15] = (checksum >> 8) & 0xFF;
-  packet[16] = checksum & 0xFF;
-
-  // 调试: 打印发送的搜索命令
-  ESP_LOGI(TAG, "Search CMD - buffer_id:%d, start:%d, num:%d", buffer_id, start_page, page_num);
-  ESP_LOG_BUFFER_HEX(TAG, packet, 17);
-
-  write_array(packet, 17);
-  flush();
-}
-
-// 构建数据包头部
-void ZW101Component::build_packet_header(uint8_t *packet, uint16_t length) {
-  packet[0] = HEADER_HIGH;
-  packet[1] = HEADER_LOW;
-  packet[2] = (DEVICE_ADDRESS >> 24) & 0xFF;
-  packet[3] = (DEVICE_ADDRESS >> 16) & 0xFF;
-  packet[4] = (DEVICE_ADDRESS >> 8) & 0xFF;
-  packet[5] = DEVICE_ADDRESS & 0xFF;
-  packet[6] = 0x01;  // 包标识: 命令包
-  packet[7] = (length >> 8) & 0xFF;
-  packet[8] = length & 0xFF;
-}
-
-// 接收响应 - 简单版本
-bool ZW101Component::receive_response() {
-  uint8_t response[50];
-  uint8_t length = wait_for_response(response, 50, 500);
-
-  // 检查确认码
-  return (length >= 12 && response[9] == 0x00);
-}
-
-// 等待并读取响应数据
-uint8_t ZW101Component::wait_for_response(uint8_t *buffer, uint8_t max_length, uint32_t timeout_ms) {
-  uint8_t index = 0;
-  uint32_t start_time = millis();
-
-  while (millis() - start_time < timeout_ms && index < max_length) {
-    if (available()) {
-      buffer[index++] = read();
+bool ZW101Component::send_search_cmd(uint8_t buffer_id, uint16_t start_page, uint16_t page_num,
+                                     ReplyCallback callback) {
+  auto frame = FRAME_SEARCH;
+  frame.set_u8(10, buffer_id).set_u16(11, start_page).set_u16(13, page_num);
+  ESP_LOGV(TAG, "Search CMD - buffer_id:%d, start:%d, num:%d", buffer_id, start_page, page_num);
+  return send_frame(frame, MATCH_TIMEOUT, std::move(callback));
+}
+
+// ==================== 指令引擎 ====================
+
+// 指令入队, 队列满时返回 false
+bool ZW101Component::enqueue_command(const uint8_t *packet, uint8_t size, uint16_t timeout_ms,
+                                     ReplyCallback callback, DataPhase data_phase) {
+  if (queue_count_ >= COMMAND_QUEUE_SIZE || size > MAX_CMD_SIZE) {
+    ESP_LOGW(TAG, "Command queue full, dropping command 0x%02X", packet[9]);
+    return false;
+  }
+
+  fill_slot(command_queue_[(queue_head_ + queue_count_) % COMMAND_QUEUE_SIZE], packet, size, timeout_ms,
+            std::move(callback), data_phase);
+  queue_count_++;
+  // 总线空闲时立即发出, 不等下一次 loop
+  transmit_next_command();
+  return true;
+}
+
+// 插到队首, 排在已排队的指令之前 (唤醒握手用); 有指令在等待应答时不能插队
+bool ZW101Component::enqueue_front(const uint8_t *packet, uint8_t size, uint16_t timeout_ms,
+                                   ReplyCallback callback) {
+  if (queue_count_ >= COMMAND_QUEUE_SIZE || command_in_flight_ || size > MAX_CMD_SIZE)
+    return false;
+
+  queue_head_ = (queue_head_ + COMMAND_QUEUE_SIZE - 1) % COMMAND_QUEUE_SIZE;
+  fill_slot(command_queue_[queue_head_], packet, size, timeout_ms, std::move(callback), DATA_NONE);
+  queue_count_++;
+  transmit_next_command();
+  return true;
+}
+
+void ZW101Component::fill_slot(PendingCommand &slot, const uint8_t *packet, uint8_t size, uint16_t timeout_ms,
+                               ReplyCallback callback, DataPhase data_phase) {
+  memcpy(slot.packet, packet, size);
+  write_address(slot.packet, address_);
+  slot.size = size;
+  slot.data_phase = data_phase;
+  slot.timeout_ms = timeout_ms;
+  slot.enqueued_us = micros();
+  slot.callback = std::move(callback);
+}
+
+// 推进指令队列, 每次 loop 调用一次, 从不等待
+void ZW101Component::process_command_queue() {
+  // 接收: 只处理已到达的字节; 共享总线时由 bus_owner_ 读取并按地址分发
+  for (uint16_t i = 0; bus_owner_ == this && i < MAX_RX_PER_LOOP && available(); i++) {
+    uint8_t data;
+    if (!read_byte(&data))
+      break;
+
+    switch (parser_.feed(data)) {
+      case FrameParser::FRAME_COMPLETE:
+        route_frame(parser_.data(), parser_.size());
+        break;
+      case FrameParser::FRAME_BAD_CHECKSUM:
+        ESP_LOGW(TAG, "Response checksum error, frame dropped");
+        trace_error(FrameTrace::TRACE_BAD_CHECKSUM, nullptr, 0);
+        mark_stream_corrupt();
+        break;
+      default:
+        break;
+    }
+  }
+
+  // 超时: 以 ACK_TIMEOUT 完成当前指令
+  if (command_in_flight_ && millis() - command_sent_time_ > command_queue_[queue_head_].timeout_ms) {
+    ESP_LOGD(TAG, "Command 0x%02X timed out", command_queue_[queue_head_].packet[9]);
+    trace_error(FrameTrace::TRACE_TIMEOUT, &command_queue_[queue_head_].packet[CMD_CODE_START_POS], 1);
+    bus_owner_->parser_.reset();
+    complete_command(ACK_TIMEOUT, nullptr, 0);
+  }
+
+  // 下载: 指令应答后每次 loop 发出一个数据包
+  if (command_in_flight_ && data_streaming_ && command_queue_[queue_head_].data_phase == DATA_SEND)
+    send_data_packet();
+
+  // 发送: 总线空闲时发出队首指令 (共享总线上轮到本实例时)
+  transmit_next_command();
+}
+
+// 发出队首指令; 没有指令在等待应答且总线空闲时才发送
+void ZW101Component::transmit_next_command() {
+  if (command_in_flight_ || queue_count_ == 0 || !bus_available())
+    return;
+  if (transmit_held())
+    return;
+  const PendingCommand &cmd = command_queue_[queue_head_];
+  trace_.record(FrameTrace::TRACE_TX, cmd.packet, cmd.size);
+  write_array(cmd.packet, cmd.size);
+  bus_owner_->bus_turn_ = bus_next_;
+  command_in_flight_ = true;
+  command_sent_time_ = millis();
+  command_sent_us_ = micros();
+  command_wait_us_ = command_sent_us_ - cmd.enqueued_us;
+}
+
+// 自动指令在模组上执行时模组只接受取消指令, 其他指令留在队列中, 应答不会与阶段应答混在一起;
+// 自动指令还在队列中 (未发出或在等合法性应答) 时排在它前面的指令照常发出, 出结果等待抬起期间也不挡
+bool ZW101Component::auto_holds_queue() const {
+  if (auto_mode_ == AUTO_MODE_NONE || rearm_after_lift_ || queue_count_ == 0)
+    return false;
+  if (command_queue_[queue_head_].packet[CMD_CODE_START_POS] == CMD_AUTO_CANCEL)
+    return false;
+  for (uint8_t i = 0; i < queue_count_; i++) {
+    uint8_t cmd = command_queue_[(queue_head_ + i) % COMMAND_QUEUE_SIZE].packet[CMD_CODE_START_POS];
+    if (cmd == CMD_AUTO_MATCH || cmd == CMD_AUTO_ENROLL)
+      return false;
+  }
+  return true;
+}
+
+// 从 data_source_ 取一包数据发出, 最后一包用结束包标识
+void ZW101Component::send_data_packet() {
+  uint16_t size = data_remaining_ < data_packet_size_ ? data_remaining_ : data_packet_size_;
+  uint16_t filled = data_source_ ? data_source_(data_packet_ + FRAME_HEAD_SIZE, size) : 0;
+  if (filled != size) {
+    ESP_LOGW(TAG, "Template source ended early, %u bytes missing", (unsigned) data_remaining_);
+    complete_command(ACK_ABORTED, nullptr, 0);
+    return;
+  }
+
+  data_remaining_ -= size;
+  bool last = data_remaining_ == 0;
+  uint16_t packet_size = finish_data_packet(data_packet_, last ? PKG_EOF : PKG_DATA, size, address_);
+  trace_.record(FrameTrace::TRACE_TX, data_packet_, packet_size);
+  write_array(data_packet_, packet_size);
+  command_sent_time_ = millis();
+  if (last)
+    complete_command(ACK_SUCCESS, nullptr, 0);
+}
+
+// 上传中丢了一包, 模板已不完整: 余下的包照常接收 (总线保持占用), 结束包到达时以 ACK_ABORTED 完成;
+// 校验失败的帧地址不可信, 按总线上正在上传的实例判断 (同一时刻只有一个实例有指令在途)
+void ZW101Component::mark_stream_corrupt() {
+  ZW101Component *reader = this;
+  do {
+    if (reader->command_in_flight_ && reader->data_streaming_ &&
+        reader->command_queue_[reader->queue_head_].data_phase == DATA_RECEIVE && !reader->stream_corrupt_) {
+      ESP_LOGW(TAG, "Template upload corrupted, draining remaining packets");
+      reader->stream_corrupt_ = true;
+    }
+    reader = reader->bus_next_;
+  } while (reader != this);
+}
+
+// 加入共享总线: 与已启动的、使用同一 UART 的实例组成环形链表
+void ZW101Component::join_bus() {
+  for (ZW101Component *peer = instances_; peer != nullptr; peer = peer->next_instance_) {
+    if (peer->parent_ != parent_)
+      continue;
+    if (peer->address_ == address_)
+      ESP_LOGE(TAG, "Readers sharing a UART need distinct addresses (0x%08X used twice)", (unsigned) address_);
+    if (target_baud_rate_ != 0 || peer->target_baud_rate_ != 0)
+      ESP_LOGE(TAG, "target_baud_rate is not supported on a shared UART");
+    bus_owner_ = peer->bus_owner_;
+    bus_next_ = peer->bus_next_;
+    peer->bus_next_ = this;
+    ESP_LOGI(TAG, "Sharing UART with reader at address 0x%08X", (unsigned) peer->address_);
+    break;
+  }
+  next_instance_ = instances_;
+  instances_ = this;
+}
+
+// 退出共享总线 (固件中组件不会销毁, 主机仿真反复创建组件时需要)
+void ZW101Component::leave_bus() {
+  for (ZW101Component **link = &instances_; *link != nullptr; link = &(*link)->next_instance_) {
+    if (*link == this) {
+      *link = next_instance_;
+      break;
+    }
+  }
+  if (bus_next_ == this)
+    return;
+
+  ZW101Component *prev = bus_next_;
+  while (prev->bus_next_ != this)
+    prev = prev->bus_next_;
+  prev->bus_next_ = bus_next_;
+  // 读取串口的实例退出时由下一个实例接替
+  ZW101Component *owner = bus_owner_ == this ? bus_next_ : bus_owner_;
+  ZW101Component *reader = bus_next_;
+  do {
+    reader->bus_owner_ = owner;
+    reader = reader->bus_next_;
+  } while (reader != bus_next_);
+  owner->bus_turn_ = nullptr;
+}
+
+// 总线上没有其他指令在途, 且没有轮到其他正在排队的实例
+bool ZW101Component::bus_available() const {
+  for (const ZW101Component *peer = bus_next_; peer != this; peer = peer->bus_next_) {
+    if (peer->command_in_flight_)
+      return false;
+  }
+  const ZW101Component *turn = bus_owner_->bus_turn_;
+  return turn == nullptr || turn == this || turn->queue_count_ == 0 || turn->transmit_held();
+}
+
+bool ZW101Component::accepts_address(uint32_t address) const {
+  return address == address_ || (address_changing_ && address == new_address_);
+}
+
+// 把收到的帧交给地址匹配的实例; 指令帧是半双工收发器回显的本机发送, 直接丢弃
+void ZW101Component::route_frame(const uint8_t *frame, uint16_t length) {
+  if (frame[6] == PKG_CMD)
+    return;
+  uint32_t address = read_address(frame);
+  ZW101Component *reader = this;
+  do {
+    if (reader->accepts_address(address)) {
+      reader->receive_frame(frame, length);
+      return;
+    }
+    reader = reader->bus_next_;
+  } while (reader != this);
+  ESP_LOGD(TAG, "Frame for unknown address 0x%08X dropped", (unsigned) address);
+}
+
+void ZW101Component::receive_frame(const uint8_t *frame, uint16_t length) {
+  trace_.record(FrameTrace::TRACE_RX, frame, length);
+  handle_frame(frame, length);
+}
+
+// 分发一个完整的应答帧
+void ZW101Component::handle_frame(const uint8_t *frame, uint16_t length) {
+  // 自动模式的后续阶段应答由模组主动上报, 不对应队首指令; 有指令在等应答时帧属于该指令
+  // (自动指令本身的合法性应答经回调处理; 执行期间其他指令被 auto_holds_queue() 挡住)
+  if (auto_mode_ != AUTO_MODE_NONE && frame[6] == PKG_ACK && !command_in_flight_) {
+    bool matching = auto_mode_ == AUTO_MODE_MATCH;
+    if (length == (matching ? AUTO_MATCH_REPLY_SIZE : AUTO_ENROLL_REPLY_SIZE)) {
+      if (matching) {
+        handle_auto_match_reply(frame[9], frame, length);
+      } else {
+        handle_auto_enroll_reply(frame[9], frame, length);
+      }
+      return;
+    }
+  }
+
+  if (!command_in_flight_) {
+    ESP_LOGD(TAG, "Unsolicited frame (pid 0x%02X, code 0x%02X) dropped", frame[6], frame[9]);
+    return;
+  }
+  DataPhase data_phase = command_queue_[queue_head_].data_phase;
+
+  // 上传: 数据包交给 data_sink_, 每包重新计时, 结束包完成指令
+  if (data_streaming_ && data_phase == DATA_RECEIVE && (frame[6] == PKG_DATA || frame[6] == PKG_EOF)) {
+    bool last = frame[6] == PKG_EOF;
+    if (data_sink_ && !stream_corrupt_)
+      data_sink_(frame + FRAME_HEAD_SIZE, length - FRAME_HEAD_SIZE - 2, last);
+    command_sent_time_ = millis();
+    if (last)
+      complete_command(stream_corrupt_ ? ACK_ABORTED : ACK_SUCCESS, frame, length);
+    return;
+  }
+
+  if (frame[6] != PKG_ACK) {
+    ESP_LOGD(TAG, "Unsolicited frame (pid 0x%02X, code 0x%02X) dropped", frame[6], frame[9]);
+    return;
+  }
+
+  // 带数据阶段的指令应答成功后不出队, 超时改为按包计算
+  if (data_phase != DATA_NONE && !data_streaming_ && frame[9] == ACK_SUCCESS) {
+    data_streaming_ = true;
+    command_sent_time_ = millis();
+    return;
+  }
+
+  complete_command(frame[9], frame, length);
+}
+
+// 出队并调用完成回调; 回调中可以继续入队新指令
+void ZW101Component::complete_command(uint8_t code, const uint8_t *frame, uint16_t length) {
+  uint8_t cmd = command_queue_[queue_head_].packet[CMD_CODE_START_POS];
+  data_streaming_ = false;
+  stream_corrupt_ = false;
+  if (code != ACK_TIMEOUT) {
+    command_stats_.record(cmd, command_wait_us_, micros() - command_sent_us_);
+    consecutive_timeouts_ = 0;
+  } else {
+    command_stats_.record_timeout(cmd, command_wait_us_);
+    if (consecutive_timeouts_ < UINT8_MAX)
+      consecutive_timeouts_++;
+  }
+
+  ReplyCallback callback = std::move(command_queue_[queue_head_].callback);
+  command_queue_[queue_head_].callback = nullptr;
+  queue_head_ = (queue_head_ + 1) % COMMAND_QUEUE_SIZE;
+  queue_count_--;
+  command_in_flight_ = false;
+
+  if (callback)
+    callback(code, frame, length);
+}
+
+// ==================== 波特率协商 ====================
+
+// 依次在当前波特率、目标波特率、出厂波特率下握手, 找到模组当前的波特率
+void ZW101Component::negotiate_baud_rate() {
+  baud_negotiating_ = true;
+  loaded_candidate_ = NO_PAGE;  // 模组可能断电重启过
+  last_baud_negotiation_ = millis();
+
+  probe_rate_count_ = 0;
+  for (uint32_t rate : {parent_->get_baud_rate(), target_baud_rate_, DEFAULT_BAUD_RATE}) {
+    bool seen = false;
+    for (uint8_t i = 0; i < probe_rate_count_; i++)
+      seen |= probe_rates_[i] == rate;
+    if (!seen)
+      probe_rates_[probe_rate_count_++] = rate;
+  }
+  probe_baud_rate(0);
+}
+
+void ZW101Component::probe_baud_rate(uint8_t index) {
+  if (index >= probe_rate_count_) {
+    ESP_LOGE(TAG, "Module not responding at any baud rate");
+    switch_uart_baud_rate(DEFAULT_BAUD_RATE);
+    finish_baud_negotiation(false);
+    return;
+  }
+
+  uint32_t rate = probe_rates_[index];
+  switch_uart_baud_rate(rate);
+  send_frame(FRAME_HANDSHAKE, 500, [this, index, rate](uint8_t code, const uint8_t *, uint16_t) {
+    if (code != ACK_SUCCESS) {
+      probe_baud_rate(index + 1);
+      return;
+    }
+    ESP_LOGD(TAG, "Module answers at %u baud", (unsigned) rate);
+    if (rate == target_baud_rate_) {
+      finish_baud_negotiation(true);
     } else {
-      // 没有数据可读时让出CPU
-      yield();
+      upgrade_baud_rate();
+    }
+  });
+}
+
+// 写波特率寄存器: 应答以旧波特率返回, 之后双方切换到目标波特率并握手确认
+void ZW101Component::upgrade_baud_rate() {
+  auto frame = FRAME_WRITE_REG;
+  frame.set_u8(10, REG_BAUD_RATE).set_u8(11, target_baud_rate_ / 9600);
+
+  send_frame(frame, COMMON_TIMEOUT, [this](uint8_t code, const uint8_t *, uint16_t) {
+    if (code != ACK_SUCCESS) {
+      ESP_LOGW(TAG, "Module refused baud rate %u (0x%02X), staying at %u", (unsigned) target_baud_rate_, code,
+               (unsigned) parent_->get_baud_rate());
+      finish_baud_negotiation(true);
+      return;
+    }
+
+    switch_uart_baud_rate(target_baud_rate_);
+    send_frame(FRAME_HANDSHAKE, 500, [this](uint8_t code, const uint8_t *, uint16_t) {
+      if (code == ACK_SUCCESS) {
+        finish_baud_negotiation(true);
+        return;
+      }
+      // 新波特率下握手失败, 退回出厂波特率
+      ESP_LOGW(TAG, "Handshake at %u baud failed, falling back to %u", (unsigned) target_baud_rate_,
+               (unsigned) DEFAULT_BAUD_RATE);
+      switch_uart_baud_rate(DEFAULT_BAUD_RATE);
+      send_frame(FRAME_HANDSHAKE, 500, [this](uint8_t code, const uint8_t *, uint16_t) {
+        finish_baud_negotiation(code == ACK_SUCCESS);
+      });
+    });
+  });
+}
+
+void ZW101Component::finish_baud_negotiation(bool ok) {
+  baud_negotiating_ = false;
+  consecutive_timeouts_ = 0;
+  if (ok)
+    ESP_LOGI(TAG, "UART running at %u baud", (unsigned) parent_->get_baud_rate());
+
+  // 启动时的协商完成后再读取模组信息
+  if (!info_read_) {
+    info_read_ = true;
+    read_fp_info();
+  }
+}
+
+// 重新配置 ESP 侧串口, 丢弃切换前收到的半帧
+void ZW101Component::switch_uart_baud_rate(uint32_t baud_rate) {
+  if (parent_->get_baud_rate() == baud_rate)
+    return;
+  parent_->set_baud_rate(baud_rate);
+  parent_->load_settings(false);
+  parser_.reset();
+  ESP_LOGD(TAG, "UART switched to %u baud", (unsigned) baud_rate);
+}
+
+// ==================== 延迟统计 ====================
+
+// 发布延迟诊断传感器 (毫秒)
+void ZW101Component::publish_command_stats() {
+  for (const auto &entry : latency_sensors_) {
+    const CommandLatency *latency = command_stats_.find(entry.cmd);
+    if (latency == nullptr || latency->count == 0)
+      continue;
+    entry.sensor->publish_state(latency->statistic_us(entry.statistic) / 1000.0f);
+  }
+}
+
+// 输出每条指令的往返延迟和直方图
+void ZW101Component::dump_command_stats() {
+  ESP_LOGI(TAG, "Command latency (round trip, ms):");
+  for (uint8_t i = 0; i < command_stats_.size(); i++) {
+    const CommandLatency &latency = command_stats_.at(i);
+    ESP_LOGI(TAG, "  0x%02X: n=%u timeouts=%u min=%.1f avg=%.1f p95=%.1f max=%.1f queue=%.1f", latency.cmd,
+             (unsigned) latency.count, (unsigned) latency.timeouts, latency.min_us / 1000.0f,
+             latency.avg_us() / 1000.0f, latency.percentile_us(95) / 1000.0f, latency.max_us / 1000.0f,
+             latency.avg_wait_us() / 1000.0f);
+
+    char buf[128];
+    size_t pos = 0;
+    for (uint8_t b = 0; b < CommandLatency::BUCKETS && pos < sizeof(buf); b++) {
+      if (b == CommandLatency::BUCKETS - 1) {
+        pos += snprintf(buf + pos, sizeof(buf) - pos, " >%u:%u",
+                        (unsigned) (CommandLatency::BUCKET_LIMITS_US[b - 1] / 1000), (unsigned) latency.buckets[b]);
+      } else {
+        pos += snprintf(buf + pos, sizeof(buf) - pos, " <=%u:%u",
+                        (unsigned) (CommandLatency::BUCKET_LIMITS_US[b] / 1000), (unsigned) latency.buckets[b]);
+      }
     }
+    ESP_LOGI(TAG, "       histogram(ms):%s", buf);
+  }
+}
+
+// ==================== 收发跟踪 ====================
+
+// 记录异常并按需输出跟踪, 限制输出频率避免刷屏
+void ZW101Component::trace_error(FrameTrace::Direction direction, const uint8_t *data, uint16_t length) {
+  trace_.record(direction, data, length);
+  if (!dump_trace_on_error_ || !trace_.enabled())
+    return;
+  uint32_t now = millis();
+  if (trace_dumped_ && now - last_trace_dump_ < TRACE_DUMP_INTERVAL_MS)
+    return;
+  trace_dumped_ = true;
+  last_trace_dump_ = now;
+  dump_trace();
+}
+
+void ZW101Component::dump_trace() {
+  if (!trace_.enabled()) {
+    ESP_LOGI(TAG, "Trace disabled (trace_buffer_size: 0)");
+    return;
   }
 
-  return index;
+  static const char *const DIRECTIONS[] = {"TX", "RX", "TO", "CK"};
+  ESP_LOGI(TAG, "Trace: %u frames, %u overwritten", (unsigned) trace_.count(), (unsigned) trace_.overwritten());
+  trace_.for_each([](const FrameTrace::Record &record, const uint8_t *data) {
+    char hex[FrameTrace::MAX_RECORD_BYTES * 2 + 1];
+    for (uint8_t i = 0; i < record.stored; i++)
+      snprintf(hex + i * 2, 3, "%02X", data[i]);
+    hex[record.stored * 2] = '\0';
+    ESP_LOGI(TAG, "trace %10u %s %3u %s", (unsigned) record.time_us, DIRECTIONS[record.direction & 3],
+             (unsigned) record.length, hex);
+  });
 }
 
 }  // namespace zw101
@@ -1,11 +1,24 @@
 #pragma once
 
 #include "esphome/core/component.h"
+#include "esphome/core/hal.h"
+#include "esphome/core/helpers.h"
+#include "esphome/core/preferences.h"
 #include "esphome/components/uart/uart.h"
 #include "esphome/components/binary_sensor/binary_sensor.h"
 #include "esphome/components/sensor/sensor.h"
 #include "esphome/components/text_sensor/text_sensor.h"
 #include "esphome/components/switch/switch.h"
+#include "zw101_candidates.h"
+#include "zw101_index.h"
+#include "zw101_protocol.h"
+#include "zw101_remap.h"
+#include "zw101_stats.h"
+#include "zw101_trace.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
 
 namespace esphome {
 namespace zw101 {
@@ -16,16 +29,14 @@ class ClearSwitch;
 
 class ZW101Component : public Component, public uart::UARTDevice {
  public:
-  // 定义指令包格式
-  static const uint8_t HEADER_HIGH = 0xEF;
-  static const uint8_t HEADER_LOW = 0x01;
-  static const uint32_t DEVICE_ADDRESS = 0xFFFFFFFF;
-
   // 定义指令码
   static const uint8_t CMD_GET_IMAGE = 0x01;     // 获取图像(匹配模式)
   static const uint8_t CMD_GET_IMAGE_ENROLL = 0x29; // 获取图像(注册模式)
   static const uint8_t CMD_GEN_CHAR = 0x02;      // 生成特征
   static const uint8_t CMD_MATCH = 0x03;         // 精确比对指纹
+  static const uint8_t CMD_LOAD_CHAR = 0x07;     // 读出模板到特征缓冲区
+  static const uint8_t CMD_UP_CHAR = 0x08;       // 上传特征缓冲区
+  static const uint8_t CMD_DOWN_CHAR = 0x09;     // 下载到特征缓冲区
   static const uint8_t CMD_SEARCH = 0x04;        // 搜索指纹
   static const uint8_t CMD_REG_MODEL = 0x05;     // 合并特征
   static const uint8_t CMD_STORE_CHAR = 0x06;    // 存储模板
@@ -33,6 +44,7 @@ class ZW101Component : public Component, public uart::UARTDevice {
   static const uint8_t CMD_CLEAR_LIB = 0x0D;     // 清空指纹库
   static const uint8_t CMD_WRITE_SYSPARA = 0x0E; // 写系统参数
   static const uint8_t CMD_READ_SYSPARA = 0x0F;  // 读模组基本参数
+  static const uint8_t CMD_SET_CHIP_ADDR = 0x15; // 设置模组地址
   static const uint8_t CMD_READ_VALID_NUMS = 0x1D; // 读有效模板个数
   static const uint8_t CMD_READ_INDEX_TABLE = 0x1F; // 读索引表
   static const uint8_t CMD_AUTO_ENROLL = 0x31;   // 自动注册
@@ -40,7 +52,47 @@ class ZW101Component : public Component, public uart::UARTDevice {
   static const uint8_t CMD_INTO_SLEEP = 0x33;    // 进入休眠
   static const uint8_t CMD_HANDSHAKE = 0x35;     // 握手
   static const uint8_t CMD_RGB_CTRL = 0x3C;      // RGB灯控制
+  static const uint8_t CMD_CHECK_FINGER = 0x9D;  // 检查手指是否在位 (不采图)
+  static const uint8_t CMD_AUTO_CANCEL = 0x30;   // 取消自动模式
+
+  // 确认码
+  static const uint8_t ACK_SUCCESS = 0x00;       // 指令执行成功
+  static const uint8_t ACK_COMM_ERR = 0x01;      // 数据包接收错误 (模组忙于自动模式时也返回)
+  static const uint8_t ACK_NO_FINGER = 0x02;     // 传感器上无手指
+  static const uint8_t ACK_NOT_SEARCHED = 0x09;  // 没有搜索到匹配
+  static const uint8_t ACK_SLEEP_ERR = 0x12;     // 休眠失败 (PS_SLEEP_ERR)
+  static const uint8_t ACK_ENROLL_TIMEOUT = 0x26; // 自动注册等待手指超时
+  static const uint8_t ACK_FP_DUPLICATION = 0x27; // 指纹已注册
+  static const uint8_t ACK_ABORTED = 0xFE;       // 数据传输被本地中止 (本地定义, 模组不会返回)
+  static const uint8_t ACK_TIMEOUT = 0xFF;       // 等待应答超时 (本地定义, 模组不会返回)
+
+  // 应答等待时间 (与原始C代码 FP_SYNO_*_TIMEOUT 一致)
+  static const uint16_t COMMON_TIMEOUT = 1000;
+  static const uint16_t CAPTURE_TIMEOUT = 480;
+  static const uint16_t MATCH_TIMEOUT = 2300;
+  static const uint16_t SLEEP_TIMEOUT = 400;
+  static const uint16_t RGB_TIMEOUT = 780;
+  static const uint16_t EMPTY_TIMEOUT = 2000;
+  static const uint16_t DATA_PACKET_TIMEOUT = 1000;  // 数据传输中相邻两包的最长间隔
+  static const uint16_t WAKE_PROBE_TIMEOUT = 50;     // 唤醒期间单次握手的等待时间
+  static const uint32_t WAKE_TIMEOUT_MS = 300;       // 唤醒后等待模组应答的最长时间 (FP_SYNO_PWRON_WAIT_PERIOD)
+
+  static const uint8_t AUTO_ENROLL_SAMPLES = 5;  // 自动注册采集次数
+
+  // 应答回调: code 为确认码 (超时为 ACK_TIMEOUT), frame/length 为完整应答帧 (超时为空)
+  using ReplyCallback = std::function<void(uint8_t code, const uint8_t *frame, uint16_t length)>;
+  // 公共方法完成回调
+  using ResultCallback = std::function<void(bool success)>;
+  // 模板上传: 每收到一个数据包调用一次, last 表示结束包
+  using DataSink = std::function<void(const uint8_t *data, uint16_t length, bool last)>;
+  // 模板下载: 向 buffer 填入 length 字节并返回实际填入的字节数, 不足时中止下载
+  using DataSource = std::function<uint16_t(uint8_t *buffer, uint16_t length)>;
+  // 批量操作完成回调: pages 为未完成的页 (下载失败的页, 或核对后缺失的页)
+  using BatchCallback = std::function<void(bool success, const std::vector<uint16_t> &pages)>;
+  // 批量下载时为每一页提供数据
+  using DataSourceFactory = std::function<DataSource(uint16_t page)>;
 
+  ~ZW101Component();
   void setup() override;
   void loop() override;
   float get_setup_priority() const override { return setup_priority::DATA; }
@@ -50,29 +102,101 @@ class ZW101Component : public Component, public uart::UARTDevice {
   void set_match_score_sensor(sensor::Sensor *sensor) { match_score_sensor_ = sensor; }
   void set_match_id_sensor(sensor::Sensor *sensor) { match_id_sensor_ = sensor; }
   void set_status_sensor(text_sensor::TextSensor *sensor) { status_sensor_ = sensor; }
+  void set_poll_interval_sensor(sensor::Sensor *sensor) { poll_interval_sensor_ = sensor; }
+  void set_search_pages_sensor(sensor::Sensor *sensor) { search_pages_sensor_ = sensor; }
+  void set_wake_latency_sensor(sensor::Sensor *sensor) { wake_latency_sensor_ = sensor; }
+  void set_sleep_time_sensor(sensor::Sensor *sensor) { sleep_time_sensor_ = sensor; }
+  void set_candidate_hit_rate_sensor(sensor::Sensor *sensor) { candidate_hit_rate_sensor_ = sensor; }
+  void add_latency_sensor(uint8_t cmd, LatencyStatistic statistic, sensor::Sensor *sensor) {
+    latency_sensors_.push_back({cmd, statistic, sensor});
+  }
   void set_enroll_switch(EnrollSwitch *sw) { enroll_switch_ = sw; }
   void set_clear_switch(ClearSwitch *sw) { clear_switch_ = sw; }
+  void set_touch_pin(InternalGPIOPin *pin) { touch_pin_ = pin; }
+  void set_target_baud_rate(uint32_t baud_rate) { target_baud_rate_ = baud_rate; }
+  // 搜索前先做 1:1 比对的候选页数 (0 为关闭, 最多 MAX_CANDIDATE_TRIES)
+  void set_candidate_count(uint8_t count) {
+    candidate_count_ = count < MAX_CANDIDATE_TRIES ? count : MAX_CANDIDATE_TRIES;
+  }
+  // 空闲时把常用用户的模板搬到靠前的页, 对外的 ID 不变
+  void set_optimize_library(bool optimize) { optimize_library_ = optimize; }
+  // 偏好设置的键按组件 ID 区分; 多个读头接在不同串口时可以都用出厂地址
+  void set_preference_key(const std::string &id) { remap_key_ = fnv1_hash("zw101_remap_" + id); }
+  // 空闲多久后自动休眠 (0 为不自动休眠); 需要触摸引脚唤醒
+  void set_sleep_timeout(uint32_t timeout_ms) { sleep_timeout_ms_ = timeout_ms; }
+  // 模组地址: 发出的帧使用该地址, 只接收该地址的应答; 多个模组共用一个串口时各自配置不同地址
+  void set_address(uint32_t address) { address_ = address; }
+  uint32_t get_address() const { return address_; }
+  void set_poll_interval_bounds(uint32_t min_ms, uint32_t max_ms) {
+    min_poll_interval_ = min_ms;
+    max_poll_interval_ = max_ms;
+    poll_interval_ = max_ms;
+  }
 
   // 公共方法
+  // 所有指令均进入指令队列异步执行, 返回值表示是否成功入队;
+  // 执行结果通过状态传感器发布, 或通过可选的完成回调获取
   bool register_fingerprint();
-  bool clear_fingerprint_library();
+  bool clear_fingerprint_library(ResultCallback on_done = nullptr);
   void read_fp_info();
-  bool read_valid_template_count();        // 读有效模板个数
-  bool handshake();                        // 握手测试
-  bool delete_fingerprint(uint16_t id);    // 删除指定指纹
-  void set_rgb_led(uint8_t mode, uint8_t color, uint8_t brightness = 100); // RGB灯控制
-  bool enter_sleep_mode();                 // 进入休眠模式
+  bool read_index_table(ResultCallback on_done = nullptr);  // 读索引表, 刷新占用位图
+  bool read_valid_template_count(ResultCallback on_done = nullptr);  // 读有效模板个数
+  bool handshake(ResultCallback on_done = nullptr);                  // 握手测试
+  bool set_module_address(uint32_t address, ResultCallback on_done = nullptr);  // 改写模组地址 (保存在模组中)
+  bool delete_fingerprint(uint16_t id, ResultCallback on_done = nullptr);  // 删除指定指纹
+  bool delete_range(uint16_t start, uint16_t count, ResultCallback on_done = nullptr);  // 删除连续的页
+  void set_rgb_led(uint8_t mode, uint8_t color, uint8_t brightness = 100); // RGB灯控制 (合并后在指令间隙发出)
+  bool enter_sleep_mode(ResultCallback on_done = nullptr);           // 等进行中的指令完成后休眠
+  bool wake_up(ResultCallback on_done = nullptr);                    // 握手确认模组已唤醒
+  bool is_asleep() const { return power_state_ == POWER_ASLEEP; }
+  uint32_t get_last_wake_latency() const { return last_wake_latency_; }  // 最近一次唤醒耗时 (毫秒)
+  uint64_t get_total_sleep_ms() const { return total_sleep_ms_; }        // 累计休眠时间, 不含当前这次
   bool auto_enroll_mode(uint16_t timeout_sec = 60); // 自动注册模式
   bool auto_match_mode();                  // 自动匹配模式
   void cancel_auto_mode();                 // 取消自动模式
+  uint8_t pending_command_count() const { return queue_count_; }  // 队列中未完成的指令数
+  uint32_t get_led_commands_skipped() const { return led_commands_skipped_; }  // 被合并或去重的灯控请求数
+  const TemplateIndex &get_template_index() const { return template_index_; }
+  // 候选比对命中 / 全部候选未命中 (之后由 1:N 搜索决定) 的次数
+  uint32_t get_candidate_hits() const { return candidate_hits_; }
+  uint32_t get_candidate_misses() const { return candidate_misses_; }
+  // 指纹库重排: 对外 ID 与模板所在页的映射, 已完成的搬移次数
+  const PageRemap &get_page_remap() const { return remap_; }
+  uint32_t get_template_moves() const { return template_moves_; }
+
+  // 模板备份/恢复: 数据按包流式传递, 不在内存中缓存整个模板;
+  // 使用特征缓冲区2, 同一时间只能进行一个传输
+  bool upload_template(uint16_t page, DataSink sink, ResultCallback on_done = nullptr);
+  bool download_template(uint16_t page, uint32_t size, DataSource source, ResultCallback on_done = nullptr);
+  uint16_t get_data_packet_size() const { return data_packet_size_; }
+
+  // 批量操作: 指令在上一条完成后才入队, 不会占满指令队列; 任一步失败即停止
+  // - delete_fingerprints: 合并为最少的区间删除, 区间可以跨过空闲页
+  // - download_templates: 依次下载并存储每一页, 每页 size 字节
+  // - reconcile_library: 读一次索引表, 删除不在 desired 中的模板, 回调中给出 desired 中缺失的页
+  bool delete_fingerprints(std::vector<uint16_t> ids, ResultCallback on_done = nullptr);
+  bool download_templates(std::vector<uint16_t> pages, uint32_t size, DataSourceFactory open,
+                          BatchCallback on_done = nullptr);
+  bool reconcile_library(std::vector<uint16_t> desired, BatchCallback on_done = nullptr);
 
-  // 控制自动搜索（简化方案 - 不依赖休眠命令）
+  // 指令延迟统计
+  const CommandStats &get_command_stats() const { return command_stats_; }
+  void dump_command_stats();   // 输出到日志
+  void reset_command_stats() { command_stats_.reset(); }
+
+  // 串口收发跟踪: 缓冲区字节数为0时关闭, 运行中也可以切换
+  void set_trace_buffer_size(size_t bytes) { trace_.set_capacity(bytes); }
+  void set_dump_trace_on_error(bool dump) { dump_trace_on_error_ = dump; }
+  const FrameTrace &get_trace() const { return trace_; }
+  void dump_trace();  // 输出到日志, 每行一帧
+
+  // 控制自动搜索（简化方案 - 不依赖休眠命令）: 模组保持唤醒, 灯控照常生效
   void disable_auto_search() {
-    sleep_mode_ = true;
+    search_enabled_ = false;
     ESP_LOGI("zw101", "Auto search disabled (LED mode)");
   }
   void enable_auto_search() {
-    sleep_mode_ = false;
+    search_enabled_ = true;
     ESP_LOGI("zw101", "Auto search enabled");
   }
 
@@ -82,6 +206,21 @@ class ZW101Component : public Component, public uart::UARTDevice {
   sensor::Sensor *match_score_sensor_{nullptr};
   sensor::Sensor *match_id_sensor_{nullptr};
   text_sensor::TextSensor *status_sensor_{nullptr};
+  sensor::Sensor *poll_interval_sensor_{nullptr};
+  sensor::Sensor *search_pages_sensor_{nullptr};
+  sensor::Sensor *wake_latency_sensor_{nullptr};
+  sensor::Sensor *sleep_time_sensor_{nullptr};
+  sensor::Sensor *candidate_hit_rate_sensor_{nullptr};
+
+  // 指令延迟诊断传感器, 每分钟发布一次
+  static const uint32_t STATS_PUBLISH_INTERVAL_MS = 60000;
+  struct LatencySensor {
+    uint8_t cmd;
+    LatencyStatistic statistic;
+    sensor::Sensor *sensor;
+  };
+  std::vector<LatencySensor> latency_sensors_;
+  uint32_t last_stats_publish_{0};
 
   // Switches
   EnrollSwitch *enroll_switch_{nullptr};
@@ -91,51 +230,328 @@ class ZW101Component : public Component, public uart::UARTDevice {
   enum EnrollState {
     ENROLL_IDLE,
     ENROLL_WAIT_FINGER,
-    ENROLL_CAPTURING,
     ENROLL_WAIT_REMOVE,
     ENROLL_MERGING,
-    ENROLL_STORING
+    ENROLL_STORING,
+    ENROLL_WAIT_REPLY  // 指令已入队, 等待应答回调
   };
   EnrollState enroll_state_{ENROLL_IDLE};
   uint8_t enroll_sample_count_{0};
   uint32_t enroll_last_action_{0};
-  uint16_t next_fingerprint_id_{0};  // 下一个可用ID (从0开始)
+  uint32_t enroll_wait_start_{0};    // 开始等待手指的时间, 用于30秒超时
   uint16_t library_capacity_{50};
 
+  // 指纹库占用位图: 启动时读索引表, 之后随存储/删除/清空同步更新
+  TemplateIndex template_index_;
+
   // 搜索流程状态
   enum SearchState {
     SEARCH_IDLE,
-    SEARCH_GET_IMAGE,
-    SEARCH_GEN_CHAR,
+    SEARCH_GET_IMAGE,  // 采图指令入队失败, 下一次 loop 重试
     SEARCH_WAIT_RETRY,
-    SEARCH_DO_SEARCH
+    SEARCH_DO_SEARCH,  // 搜索指令入队失败, 下一次 loop 重试
+    SEARCH_WAIT_LIFT,  // 出结果后等待手指离开, 期间只做在位探测
+    SEARCH_WAIT_REPLY  // 指令已入队, 等待应答回调
   };
   SearchState search_state_{SEARCH_IDLE};
   uint8_t search_retry_count_{0};
   uint32_t search_last_action_{0};
+  bool rearm_after_lift_{false};  // 自动验证出结果后的等待抬起: 手指离开后重新启动自动验证
+
+  // 搜索区间: 只搜索已占用的页, 相距较远的几簇分段搜索, 找到即停
+  static const uint8_t MAX_SEARCH_RANGES = 3;
+  static const uint16_t SEARCH_SPLIT_GAP = 64;  // 空白不短于此页数才值得多发一条搜索指令
+  TemplateIndex::PageRange search_ranges_[MAX_SEARCH_RANGES];
+  uint8_t search_range_count_{0};
+  uint8_t search_range_index_{0};
+  uint16_t search_pages_{0};  // 本次搜索已覆盖的页数
+
+  // 候选优先: 特征生成后先把常用页的模板读到缓冲区2做 1:1 比对 (PS_Match), 都不匹配再做 1:N 搜索;
+  // 缓冲区2中已是某个候选的模板时先比对它, 省去一次读出
+  static const uint8_t MAX_CANDIDATE_TRIES = 8;
+  static const uint16_t NO_PAGE = 0xFFFF;
+  CandidateList candidates_;
+  uint8_t candidate_count_{0};
+  uint16_t candidate_order_[MAX_CANDIDATE_TRIES];
+  uint8_t candidate_tries_{0};
+  uint8_t candidate_index_{0};
+  uint16_t loaded_candidate_{NO_PAGE};  // 缓冲区2中模板所在的页; 注册、模板传输、自动模式、唤醒后失效
+  uint32_t candidate_hits_{0};
+  uint32_t candidate_misses_{0};
+
+  // 指纹库重排: 1:N 搜索按页号从小到大比对, 找到即停; 空闲时把匹配次数多的模板搬到前面的空页,
+  // 或先把前面更冷的模板搬到后面。对外的 ID 经 remap_ 换算成页, 映射和搬移日志保存在偏好设置中,
+  // 每一步之前落盘, 重启后按日志完成或放弃中断的搬移
+  static const uint32_t RELOCATE_IDLE_MS = 5000;   // 距离上一次搜索活动多久后开始重排
+  static const uint8_t RELOCATE_MIN_HITS = 3;      // 匹配次数达到此值的模板才搬移
+  static const uint32_t RELOCATE_RETRY_MS = 1000;  // 搬移出错后的重试间隔
+  PageRemap remap_;
+  ESPPreferenceObject remap_pref_;
+  uint32_t remap_key_{fnv1_hash("zw101_remap")};  // 与地址一起组成偏好设置的键
+  bool optimize_library_{false};
+  bool relocate_pending_{false};  // 有新的匹配或刚完成一次搬移, 需要重新规划
+  bool relocating_{false};        // 搬移日志未结束: 暂停搜索和注册, 拒绝改动指纹库
+  uint32_t relocate_retry_at_{0};  // 非0时到该时间按日志继续搬移
+  uint32_t template_moves_{0};
+
+  // 自适应轮询: 有活动后按最短间隔轮询, 安静一段时间后每次空轮询放慢1.5倍, 直到最长间隔
+  static const uint32_t POLL_ACTIVE_HOLD_MS = 5000;  // 活动后保持最短间隔的时间
+  uint32_t min_poll_interval_{150};
+  uint32_t max_poll_interval_{600};
+  uint32_t poll_interval_{600};
+  uint32_t last_activity_{0};
+
+  // 在位探测: 优先用 PS_CheckFinger (0x9D), 模组不支持时退回采图
+  bool check_finger_supported_{true};
 
   // 匹配成功状态
   bool match_found_{false};
   uint32_t match_clear_time_{0};
 
+  // RGB 灯: 只保留最后一次请求的状态, 在其他指令之间发出 (对应 fp_syno_protocol.c 的 rgb_cmd_cache);
+  // 与模组上已生效的状态相同时不发送
+  struct LedState {
+    uint8_t mode;
+    uint8_t color;
+    uint8_t brightness;
+    bool operator==(const LedState &other) const {
+      return mode == other.mode && color == other.color && brightness == other.brightness;
+    }
+  };
+  LedState led_requested_{};
+  LedState led_applied_{};
+  bool led_pending_{false};        // 有尚未发出的请求
+  bool led_in_flight_{false};      // 灯控指令已入队, 等待应答
+  bool led_applied_known_{false};  // led_applied_ 有效; 灯控失败或模组自行控制灯光后失效
+  uint32_t led_commands_skipped_{0};
+
   // 初始化标志
   bool info_read_{false};
+  bool led_off_sent_{false};  // 启动后关闭模组默认灯光, 每个实例各自一次
 
-  // 休眠和自动模式状态
-  bool sleep_mode_{false};
-  bool auto_mode_active_{false};
+  // 触摸唤醒 (可选): 模组 TOUCH_OUT 上升沿由中断置位, 未配置时退回1秒轮询
+  InternalGPIOPin *touch_pin_{nullptr};
+  volatile bool touch_triggered_{false};
+
+  // 波特率协商 (可选): 启动时通过写系统寄存器把模组切换到目标波特率, 失败时退回出厂波特率
+  static const uint32_t DEFAULT_BAUD_RATE = 57600;  // 模组出厂波特率 (FP_SYNO_DEFAULT_BAUD)
+  static const uint8_t REG_BAUD_RATE = 4;           // 系统寄存器4: 波特率控制 N (N x 9600)
+  static const uint8_t BAUD_REPROBE_TIMEOUTS = 3;   // 连续超时达到此次数后重新探测 (模组可能断电重启过)
+  static const uint32_t BAUD_REPROBE_INTERVAL_MS = 10000;
+  uint32_t target_baud_rate_{0};
+  bool baud_negotiating_{false};
+  uint32_t probe_rates_[3];
+  uint8_t probe_rate_count_{0};
+  uint8_t consecutive_timeouts_{0};
+  uint32_t last_baud_negotiation_{0};
+
+  // 电源管理: 休眠前等队列中的指令完成, 休眠指令失败时重试;
+  // 休眠期间指令留在队列中, 触摸或有指令排队时先握手确认模组已上电, 再继续发送
+  enum PowerState : uint8_t {
+    POWER_AWAKE,
+    POWER_DRAINING,  // 等待进行中的指令完成
+    POWER_SLEEPING,  // 休眠指令已发出或等待重试
+    POWER_ASLEEP,
+    POWER_WAKING,    // 只发唤醒握手, 直到模组应答或超时
+  };
+  static const uint8_t SLEEP_MAX_RETRIES = 3;        // 对应原始C代码 sleep_cmd_retry
+  static const uint32_t SLEEP_RETRY_DELAY_MS = 200;
+  PowerState power_state_{POWER_AWAKE};
+  uint8_t sleep_retries_{0};
+  uint32_t sleep_retry_at_{0};     // 非0时到该时间重发休眠指令
+  uint32_t sleep_started_{0};
+  uint32_t wake_started_{0};
+  bool wake_probe_queued_{false};  // 唤醒握手在队首, 只放行这一条
+  uint32_t sleep_timeout_ms_{0};
+  uint32_t last_wake_latency_{0};
+  uint64_t total_sleep_ms_{0};
+  ResultCallback sleep_done_;
+  ResultCallback wake_done_;
+
+  // 自动搜索开关与自动模式状态
+  bool search_enabled_{true};
+  enum AutoMode : uint8_t {
+    AUTO_MODE_NONE,
+    AUTO_MODE_ENROLL,
+    AUTO_MODE_MATCH,
+  };
+  AutoMode auto_mode_{AUTO_MODE_NONE};
   uint32_t auto_mode_timeout_{0};
 
+  // 自动验证 (PS_AutoIdentify) 阶段应答: 确认码 + 阶段(1) + 页码(2) + 得分(2)
+  static const uint8_t AUTO_STAGE_LEGALITY = 0x00;  // 指令合法性检查
+  static const uint8_t AUTO_STAGE_GET_IMAGE = 0x01; // 采图
+  static const uint8_t AUTO_STAGE_SEARCH = 0x05;    // 搜索结果, 模组随后回到空闲
+  static const uint16_t AUTO_MATCH_REPLY_SIZE = FRAME_HEAD_SIZE + 1 + 5 + 2;
+
+  // 自动注册 (PS_AutoEnroll) 阶段应答: 确认码 + 阶段(1) + 第几次采集/子步骤(1)
+  static const uint8_t AUTO_STAGE_GEN_CHAR = 0x02;     // 生成特征
+  static const uint8_t AUTO_STAGE_FINGER_LEAVE = 0x03; // 等待手指离开
+  static const uint8_t AUTO_STAGE_MERGE = 0x04;        // 合并模板
+  static const uint8_t AUTO_STAGE_DUPLICATE = 0x05;    // 指纹查重
+  static const uint8_t AUTO_STAGE_STORE = 0x06;        // 存储模板, 注册结束
+  static const uint16_t AUTO_ENROLL_REPLY_SIZE = FRAME_HEAD_SIZE + 1 + 2 + 2;
+  uint16_t auto_enroll_page_{0};
+
+  // 应答帧解析器; 共享总线时只使用 bus_owner_ 的解析器
+  FrameParser parser_;
+
+  // 模组地址与共享总线: 接在同一个 UART 上的实例组成环形链表, 由第一个实例读取串口并按地址分发应答;
+  // 总线上同一时间只有一条指令在途, 多个实例都有指令排队时轮流发送
+  uint32_t address_{BROADCAST_ADDRESS};
+  uint32_t new_address_{BROADCAST_ADDRESS};  // 改写地址期间, 应答已使用新地址
+  bool address_changing_{false};
+  ZW101Component *bus_owner_{this};
+  ZW101Component *bus_next_{this};
+  ZW101Component *bus_turn_{nullptr};  // 仅 bus_owner_ 使用: 下一个优先发送的实例
+  ZW101Component *next_instance_{nullptr};
+  static ZW101Component *instances_;
+
+  // 模板数据传输: 指令应答成功后进入数据阶段, 上传时逐包交给 data_sink_,
+  // 下载时每次 loop 从 data_source_ 取一包发出, 发完结束包后指令完成
+  enum DataPhase : uint8_t {
+    DATA_NONE,
+    DATA_RECEIVE,  // 应答后模组发送数据包
+    DATA_SEND,     // 应答后由主机发送数据包
+  };
+  static const uint8_t TRANSFER_BUFFER = 2;  // 特征缓冲区1留给搜索
+  uint16_t data_packet_size_{128};           // 系统参数中的数据包大小
+  bool transfer_active_{false};
+  bool data_streaming_{false};  // 当前指令已应答, 正在传输数据包
+  bool stream_corrupt_{false};  // 上传中有数据包校验失败, 余下的包只接收不交给 data_sink_
+  uint32_t data_remaining_{0};  // 下载剩余字节数
+  DataSink data_sink_;
+  DataSource data_source_;
+  uint8_t data_packet_[FrameParser::MAX_FRAME_SIZE];
+
+  // 指令队列: 队首为正在执行(已发送或待发送)的指令
+  static const uint8_t MAX_CMD_SIZE = 20;
+  static const uint8_t COMMAND_QUEUE_SIZE = 8;
+  static const uint16_t MAX_RX_PER_LOOP = FrameParser::MAX_FRAME_SIZE;  // 每次 loop 最多处理的接收字节数
+  struct PendingCommand {
+    uint8_t packet[MAX_CMD_SIZE];
+    uint8_t size;
+    DataPhase data_phase;
+    uint16_t timeout_ms;
+    uint32_t enqueued_us;  // 入队时间, 用于统计排队耗时
+    ReplyCallback callback;
+  };
+  PendingCommand command_queue_[COMMAND_QUEUE_SIZE];
+  uint8_t queue_head_{0};
+  uint8_t queue_count_{0};
+  bool command_in_flight_{false};
+  uint32_t command_sent_time_{0};
+  uint32_t command_sent_us_{0};
+  uint32_t command_wait_us_{0};  // 当前指令在队列中等待的时间
+  CommandStats command_stats_;
+
+  // 串口收发跟踪; 指令超时或校验和错误时可自动输出, 最多每分钟一次
+  static const uint32_t TRACE_DUMP_INTERVAL_MS = 60000;
+  FrameTrace trace_;
+  bool dump_trace_on_error_{false};
+  uint32_t last_trace_dump_{0};
+  bool trace_dumped_{false};
+  void trace_error(FrameTrace::Direction direction, const uint8_t *data, uint16_t length);
+
   // 内部方法
   void process_enrollment();
+  void process_power();
+  bool idle_for_sleep(uint32_t now) const;
+  void send_sleep_command();
+  void handle_sleep_reply(uint8_t code);
+  void start_wake();
+  void finish_wake(bool ok);
+  void abort_queued_commands();
   void process_search();  // 新增非阻塞搜索处理
-  void send_cmd(uint8_t cmd);
-  void send_cmd2(uint8_t cmd, uint8_t param1);
-  void send_store_cmd(uint8_t buffer_id, uint16_t template_id);
-  void send_search_cmd(uint8_t buffer_id, uint16_t start_page, uint16_t page_num);
-  void build_packet_header(uint8_t *packet, uint16_t length);
-  bool receive_response();
-  uint8_t wait_for_response(uint8_t *buffer, uint8_t max_length, uint32_t timeout_ms);
+  void handle_search_reply(uint8_t code, const uint8_t *frame, uint16_t length);
+  void search_capture();
+  void search_current_range();
+  uint8_t plan_candidates();
+  void match_candidate();
+  void compare_candidate(uint16_t page);
+  void next_candidate();
+  void publish_candidate_hit_rate();
+  void publish_match(uint16_t page, uint16_t score);
+  uint16_t template_id(uint16_t page) const;
+  bool idle_for_relocation(uint32_t now) const;
+  bool plan_relocation(uint16_t *src, uint16_t *dst);
+  void start_relocation(uint16_t src, uint16_t dst);
+  void resume_relocation();
+  void copy_template();
+  void finish_copy();
+  void delete_moved_source();
+  void abandon_relocation();
+  void retry_relocation();
+  bool save_remap();
+  bool relocation_blocks() const;
+  void flush_led();
+  void send_led_request();
+  void wait_for_lift();    // 匹配或失败后进入等待抬起
+  void finish_lift_wait();  // 手指已离开: 回到空闲, 自动验证模式下重新启动
+  bool arm_auto_match();
+  void handle_auto_match_reply(uint8_t code, const uint8_t *frame, uint16_t length);
+  void handle_auto_enroll_reply(uint8_t code, const uint8_t *frame, uint16_t length);
+  void finish_auto_enroll(const char *status);
+  uint8_t plan_search_ranges(TemplateIndex::PageRange *ranges, uint8_t max_ranges);
+  bool finger_present();  // 未配置触摸引脚时总是返回 true
+  bool probe_finger(ResultCallback on_done);  // 向模组查询手指是否在位
+  void note_search_activity();  // 采图失败、匹配等活动: 回到最短轮询间隔
+  void decay_poll_interval();   // 空轮询: 逐步放慢
+  void publish_poll_interval();
+  void negotiate_baud_rate();
+  void probe_baud_rate(uint8_t index);
+  void upgrade_baud_rate();
+  void finish_baud_negotiation(bool ok);
+  void switch_uart_baud_rate(uint32_t baud_rate);
+  static void touch_isr(ZW101Component *arg);
+  void enroll_merge();
+  void enroll_store();
+  using CaptureCallback = std::function<void(uint8_t cmd, uint8_t code)>;
+  bool capture_features(bool enroll, uint8_t buffer_id, CaptureCallback on_done);
+  bool send_gen_char_cmd(uint8_t buffer_id, ReplyCallback callback);
+  bool send_store_cmd(uint8_t buffer_id, uint16_t template_id, ReplyCallback callback);
+  bool send_search_cmd(uint8_t buffer_id, uint16_t start_page, uint16_t page_num, ReplyCallback callback);
+
+  // 发送预先构建好的指令帧 (见 zw101_protocol.h 的 make_command_frame)
+  template<size_t N>
+  bool send_frame(const CommandFrame<N> &frame, uint16_t timeout_ms, ReplyCallback callback,
+                  DataPhase data_phase = DATA_NONE) {
+    static_assert(N <= MAX_CMD_SIZE, "command frame exceeds queue slot");
+    return enqueue_command(frame.data, N, timeout_ms, std::move(callback), data_phase);
+  }
+
+  // 指令引擎
+  bool enqueue_command(const uint8_t *packet, uint8_t size, uint16_t timeout_ms, ReplyCallback callback,
+                       DataPhase data_phase = DATA_NONE);
+  // 模组休眠时指令留在队列中; 唤醒期间只发唤醒握手; 自动指令执行期间只发取消指令
+  bool transmit_held() const {
+    return power_state_ == POWER_ASLEEP || (power_state_ == POWER_WAKING && !wake_probe_queued_) ||
+           auto_holds_queue();
+  }
+  bool auto_holds_queue() const;
+  bool enqueue_front(const uint8_t *packet, uint8_t size, uint16_t timeout_ms, ReplyCallback callback);
+  void fill_slot(PendingCommand &slot, const uint8_t *packet, uint8_t size, uint16_t timeout_ms,
+                 ReplyCallback callback, DataPhase data_phase);
+  void process_command_queue();
+  void transmit_next_command();
+  void join_bus();
+  void leave_bus();
+  bool bus_available() const;
+  bool accepts_address(uint32_t address) const;
+  void route_frame(const uint8_t *frame, uint16_t length);
+  void receive_frame(const uint8_t *frame, uint16_t length);
+  void send_data_packet();
+  void mark_stream_corrupt();
+  void finish_transfer(bool ok, const ResultCallback &on_done);
+  bool delete_pages(uint16_t start, uint16_t count, ResultCallback on_done);
+  bool delete_next_range(std::shared_ptr<std::vector<TemplateIndex::PageRange>> ranges, size_t next,
+                         ResultCallback on_done);
+  bool download_next_template(std::shared_ptr<std::vector<uint16_t>> pages, size_t next, uint32_t size,
+                              DataSourceFactory open, std::shared_ptr<std::vector<uint16_t>> failed,
+                              BatchCallback on_done);
+  void handle_frame(const uint8_t *frame, uint16_t length);
+  void complete_command(uint8_t code, const uint8_t *frame, uint16_t length);
+  void publish_command_stats();
 };
 
 // 注册指纹开关
@@ -0,0 +1,72 @@
+#include "zw101_candidates.h"
+
+namespace esphome {
+namespace zw101 {
+
+int CandidateList::find(uint16_t page) const {
+  for (uint8_t i = 0; i < count_; i++) {
+    if (entries_[i].page == page)
+      return i;
+  }
+  return -1;
+}
+
+void CandidateList::record(uint16_t page) {
+  Entry entry{page, 1};
+  int index = find(page);
+  if (index >= 0) {
+    entry.hits = entries_[index].hits;
+    remove(page);
+    // 计数饱和时全部减半, 让常用用户的变化能反映到排序上
+    if (entry.hits == UINT8_MAX) {
+      for (uint8_t i = 0; i < count_; i++)
+        entries_[i].hits /= 2;
+      entry.hits /= 2;
+    }
+    entry.hits++;
+  } else if (count_ == MAX_TRACKED) {
+    count_--;
+  }
+  insert(entry);
+}
+
+uint32_t CandidateList::total_hits() const {
+  uint32_t total = 0;
+  for (uint8_t i = 0; i < count_; i++)
+    total += entries_[i].hits;
+  return total;
+}
+
+uint8_t CandidateList::hits_of(uint16_t page) const {
+  int index = find(page);
+  return index < 0 ? 0 : entries_[index].hits;
+}
+
+void CandidateList::remove(uint16_t page) {
+  int index = find(page);
+  if (index < 0)
+    return;
+  for (uint8_t i = index; i + 1 < count_; i++)
+    entries_[i] = entries_[i + 1];
+  count_--;
+}
+
+void CandidateList::rename(uint16_t from, uint16_t to) {
+  remove(to);
+  int index = find(from);
+  if (index >= 0)
+    entries_[index].page = to;
+}
+
+void CandidateList::insert(Entry entry) {
+  uint8_t pos = 0;
+  while (pos < count_ && entries_[pos].hits > entry.hits)
+    pos++;
+  for (uint8_t i = count_; i > pos; i--)
+    entries_[i] = entries_[i - 1];
+  entries_[pos] = entry;
+  count_++;
+}
+
+}  // namespace zw101
+}  // namespace esphome
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+
+namespace esphome {
+namespace zw101 {
+
+// 1:1 快速比对的候选页: 最近匹配成功过的页, 按匹配次数从多到少排列, 次数相同时最近匹配的在前
+// 记录的页数多于实际比对的页数, 偶尔出现的用户不会把常用用户挤出列表;
+// 列表很短, 插入和查找都是线性的; 满时淘汰排在最后的页
+class CandidateList {
+ public:
+  static const uint8_t MAX_TRACKED = 16;
+
+  uint8_t count() const { return count_; }
+  uint16_t at(uint8_t index) const { return entries_[index].page; }  // 按比对顺序
+  uint8_t hits(uint8_t index) const { return entries_[index].hits; }
+  uint32_t total_hits() const;
+  uint8_t hits_of(uint16_t page) const;  // 未记录的页为 0
+
+  void record(uint16_t page);  // 该页匹配成功一次
+  void remove(uint16_t page);  // 模板被删除或覆盖
+  void rename(uint16_t from, uint16_t to);  // 模板搬到了另一页, 匹配次数随之保留
+  void clear() { count_ = 0; }
+
+ protected:
+  struct Entry {
+    uint16_t page;
+    uint8_t hits;
+  };
+
+  int find(uint16_t page) const;
+  void insert(Entry entry);  // 插到匹配次数不多于它的第一项之前
+
+  Entry entries_[MAX_TRACKED];
+  uint8_t count_{0};
+};
+
+}  // namespace zw101
+}  // namespace esphome
@@ -0,0 +1,130 @@
+#include "zw101_index.h"
+
+namespace esphome {
+namespace zw101 {
+
+void TemplateIndex::load_table(uint8_t table, const uint8_t *bytes) {
+  if (table * PAGES_PER_TABLE >= MAX_PAGES)
+    return;
+
+  uint32_t *words = &words_[table * PAGES_PER_TABLE / 32];
+  for (size_t i = 0; i < TABLE_BYTES / 4; i++) {
+    const uint8_t *b = &bytes[i * 4];
+    words[i] = b[0] | (b[1] << 8) | (b[2] << 16) | (static_cast<uint32_t>(b[3]) << 24);
+  }
+  if (table == loaded_tables_)
+    loaded_tables_++;
+}
+
+void TemplateIndex::set_used(uint16_t page, bool used) {
+  if (page >= MAX_PAGES)
+    return;
+  uint32_t mask = 1UL << (page % 32);
+  if (used) {
+    words_[page / 32] |= mask;
+  } else {
+    words_[page / 32] &= ~mask;
+  }
+}
+
+void TemplateIndex::clear() {
+  for (auto &word : words_)
+    word = 0;
+}
+
+int TemplateIndex::next_page(uint16_t from, bool used) const {
+  for (uint8_t i = from / 32; i < WORDS && i * 32 < capacity_; i++) {
+    uint32_t word = used ? words_[i] : ~words_[i];
+    if (i == from / 32)
+      word &= 0xFFFFFFFFUL << (from % 32);
+    if (word == 0)
+      continue;
+    uint16_t page = i * 32 + __builtin_ctz(word);
+    return page < capacity_ ? page : -1;
+  }
+  return -1;
+}
+
+uint8_t TemplateIndex::covering_ranges(PageRange *ranges, uint8_t max_ranges, uint16_t min_gap) const {
+  if (max_ranges > MAX_RANGES)
+    max_ranges = MAX_RANGES;
+  int first = next_page(0, true);
+  if (first < 0 || max_ranges == 0)
+    return 0;
+
+  // 逐段跳过已占用和空闲的连续页, 记录最长的 max_ranges-1 处空白 (按长度降序)
+  PageRange gaps[MAX_RANGES];
+  uint8_t gap_count = 0;
+  uint16_t last;
+  int page = first;
+  while (true) {
+    int free = next_page(page, false);
+    if (free < 0) {
+      last = capacity_ - 1;
+      break;
+    }
+    int used = next_page(free, true);
+    if (used < 0) {
+      last = free - 1;
+      break;
+    }
+    PageRange gap{static_cast<uint16_t>(free), static_cast<uint16_t>(used - free)};
+    if (gap.count >= min_gap) {
+      uint8_t pos = gap_count;
+      while (pos > 0 && gaps[pos - 1].count < gap.count)
+        pos--;
+      if (pos < max_ranges - 1) {
+        for (uint8_t i = (gap_count < max_ranges - 1 ? gap_count : max_ranges - 2); i > pos; i--)
+          gaps[i] = gaps[i - 1];
+        gaps[pos] = gap;
+        if (gap_count < max_ranges - 1)
+          gap_count++;
+      }
+    }
+    page = used;
+  }
+
+  // 拆分点按位置排序后输出区间
+  for (uint8_t i = 1; i < gap_count; i++) {
+    for (uint8_t j = i; j > 0 && gaps[j - 1].start > gaps[j].start; j--) {
+      PageRange tmp = gaps[j];
+      gaps[j] = gaps[j - 1];
+      gaps[j - 1] = tmp;
+    }
+  }
+  uint16_t start = first;
+  for (uint8_t i = 0; i < gap_count; i++) {
+    ranges[i] = {start, static_cast<uint16_t>(gaps[i].start - start)};
+    start = gaps[i].start + gaps[i].count;
+  }
+  ranges[gap_count] = {start, static_cast<uint16_t>(last - start + 1)};
+  return gap_count + 1;
+}
+
+std::vector<TemplateIndex::PageRange> TemplateIndex::merge_deletions(const std::vector<uint16_t> &pages) const {
+  std::vector<PageRange> ranges;
+  bool loaded = is_loaded();
+  for (uint16_t page : pages) {
+    if (!ranges.empty()) {
+      PageRange &last = ranges.back();
+      uint16_t end = last.start + last.count;  // 区间后的第一页
+      int used = loaded && page > end ? next_page(end, true) : -1;
+      if (page == end || (loaded && page > end && (used < 0 || used >= page))) {
+        last.count = page - last.start + 1;
+        continue;
+      }
+    }
+    ranges.push_back({page, 1});
+  }
+  return ranges;
+}
+
+uint16_t TemplateIndex::count() const {
+  uint16_t total = 0;
+  for (auto word : words_)
+    total += __builtin_popcount(word);
+  return total;
+}
+
+}  // namespace zw101
+}  // namespace esphome
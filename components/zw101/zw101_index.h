@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace esphome {
+namespace zw101 {
+
+// 指纹库索引表缓存 (PS_ReadIndexTable 读回的占用位图)
+// 每页1位, 字节内低位在前, 与模组索引表一致; 在 RAM 中按32位字存放,
+// 查找空位时整字取反后用 ctz 定位, 不再逐位扫描
+class TemplateIndex {
+ public:
+  static const uint16_t PAGES_PER_TABLE = 256;  // 每张索引表 32 字节
+  static const uint16_t MAX_PAGES = 1024;       // 最多缓存 4 张索引表
+  static const size_t TABLE_BYTES = PAGES_PER_TABLE / 8;
+  static const uint8_t MAX_RANGES = 4;
+
+  // 连续页区间 [start, start + count)
+  struct PageRange {
+    uint16_t start;
+    uint16_t count;
+  };
+
+  void set_capacity(uint16_t capacity) { capacity_ = capacity < MAX_PAGES ? capacity : MAX_PAGES; }
+  uint16_t get_capacity() const { return capacity_; }
+  uint8_t table_count() const { return (capacity_ + PAGES_PER_TABLE - 1) / PAGES_PER_TABLE; }
+
+  // 载入第 table 张索引表 (32 字节); 全部载入后 is_loaded() 为 true
+  void load_table(uint8_t table, const uint8_t *bytes);
+  void invalidate() { loaded_tables_ = 0; }
+  bool is_loaded() const { return table_count() > 0 && loaded_tables_ >= table_count(); }
+
+  bool is_used(uint16_t page) const { return page < MAX_PAGES && (words_[page / 32] >> (page % 32)) & 1; }
+  void set_used(uint16_t page, bool used);
+  void clear();  // 清空指纹库后全部置空
+
+  // 第一个空闲页, 库满时返回 -1
+  int find_free() const { return next_page(0, false); }
+  // 从 from 开始第一个已占用页, 没有时返回 -1
+  int next_used(uint16_t from) const { return next_page(from, true); }
+  // 从 from 开始第一个空闲页, 没有时返回 -1
+  int next_free(uint16_t from) const { return next_page(from, false); }
+  uint16_t count() const;
+
+  // 计算覆盖全部已占用页的搜索区间: 在不短于 min_gap 的空白处拆分, 最多 max_ranges 段,
+  // 空白过多时只在最长的几处拆分; 返回区间数, 库为空时返回 0
+  uint8_t covering_ranges(PageRange *ranges, uint8_t max_ranges, uint16_t min_gap) const;
+
+  // 把待删除的页 (升序、无重复) 合并为最少的连续区间: 两页之间全部空闲时并入同一区间
+  // (删除空页没有副作用), 区间不会跨过未列出的已占用页; 索引表未载入时只合并相邻页
+  std::vector<PageRange> merge_deletions(const std::vector<uint16_t> &pages) const;
+
+ protected:
+  static const uint8_t WORDS = MAX_PAGES / 32;
+
+  // 从 from 开始第一个已占用(used)或空闲页, 没有时返回 -1
+  int next_page(uint16_t from, bool used) const;
+
+  uint32_t words_[WORDS]{};
+  uint16_t capacity_{0};
+  uint8_t loaded_tables_{0};  // 已连续载入的索引表数
+};
+
+}  // namespace zw101
+}  // namespace esphome
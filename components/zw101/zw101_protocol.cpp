@@ -0,0 +1,92 @@
+#include "zw101_protocol.h"
+
+namespace esphome {
+namespace zw101 {
+
+uint16_t finish_data_packet(uint8_t *packet, uint8_t pid, uint16_t length, uint32_t address) {
+  uint16_t pkg_len = length + 2;
+  packet[0] = FIRST_HEAD;
+  packet[1] = SECOND_HEAD;
+  write_address(packet, address);
+  packet[6] = pid;
+  packet[7] = pkg_len >> 8;
+  packet[8] = pkg_len & 0xFF;
+
+  uint16_t sum = pid + packet[7] + packet[8];
+  for (uint16_t i = 0; i < length; i++)
+    sum += packet[FRAME_HEAD_SIZE + i];
+  packet[FRAME_HEAD_SIZE + length] = sum >> 8;
+  packet[FRAME_HEAD_SIZE + length + 1] = sum & 0xFF;
+  return FRAME_HEAD_SIZE + length + 2;
+}
+
+void FrameParser::reset() {
+  state_ = RCV_FIRST_HEAD;
+  size_ = 0;
+  pkg_dlen_ = 0;
+  sum_ = 0;
+}
+
+FrameParser::Result FrameParser::feed(uint8_t data) {
+  switch (state_) {
+    case RCV_FIRST_HEAD:
+      if (data == FIRST_HEAD) {
+        reset();
+        buf_[size_++] = data;
+        state_ = RCV_SECOND_HEAD;
+      }
+      break;
+
+    case RCV_SECOND_HEAD:
+      if (data == SECOND_HEAD) {
+        buf_[size_++] = data;
+        state_ = RCV_PKG_SIZE;
+      } else if (data != FIRST_HEAD) {
+        // 0xEF 0xEF 0x01 时保留第二个 0xEF 作为新包头
+        reset();
+      }
+      break;
+
+    case RCV_PKG_SIZE:
+      buf_[size_++] = data;
+      if (size_ > CALC_SUM_START_POS)
+        sum_ += data;
+      if (size_ >= FRAME_HEAD_SIZE) {
+        pkg_dlen_ = (buf_[7] << 8) | buf_[8];
+        // 长度至少包含校验和, 超出缓冲区的帧视为噪声, 重新同步
+        if (pkg_dlen_ < 2 || FRAME_HEAD_SIZE + pkg_dlen_ > MAX_FRAME_SIZE) {
+          reset();
+          break;
+        }
+        state_ = RCV_DATAS;
+      }
+      break;
+
+    case RCV_DATAS: {
+      buf_[size_++] = data;
+      uint16_t frame_size = FRAME_HEAD_SIZE + pkg_dlen_;
+      if (size_ <= frame_size - 2)
+        sum_ += data;
+      if (size_ < frame_size)
+        break;
+
+      // 帧完整, 核对校验和
+      state_ = RCV_FIRST_HEAD;
+      uint16_t rcv_sum = (buf_[size_ - 2] << 8) | buf_[size_ - 1];
+      if (rcv_sum != sum_) {
+        size_ = 0;
+        return FRAME_BAD_CHECKSUM;
+      }
+      return FRAME_COMPLETE;
+    }
+
+    default:
+      reset();
+      break;
+  }
+
+  return FRAME_PENDING;
+}
+
+}  // namespace zw101
+}  // namespace esphome
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace zw101 {
+
+// 包头与缺省地址 (模组出厂地址)
+static const uint8_t FIRST_HEAD = 0xEF;
+static const uint8_t SECOND_HEAD = 0x01;
+static const uint32_t BROADCAST_ADDRESS = 0xFFFFFFFF;
+static const uint8_t ADDRESS_POS = 2;  // 地址字段, 大端; 不计入校验和
+
+// 包标识
+static const uint8_t PKG_CMD = 0x01;   // 命令包
+static const uint8_t PKG_DATA = 0x02;  // 数据包
+static const uint8_t PKG_ACK = 0x07;   // 应答包
+static const uint8_t PKG_EOF = 0x08;   // 结束包
+
+// 帧内固定位置
+static const uint8_t CALC_SUM_START_POS = 6;        // 校验和从包标识开始计算
+static const uint8_t CMD_CODE_START_POS = 9;        // 指令码/确认码
+static const uint8_t VARIABLE_FIELD_START_POS = 10;  // 参数起始
+static const uint8_t FRAME_HEAD_SIZE = 9;           // 包头(2) + 地址(4) + 包标识(1) + 长度(2)
+static const uint16_t MAX_DATA_PACKET_SIZE = 256;   // 数据包最大负载 (系统参数包大小 N=3)
+
+// 完整指令帧: 包头 + 地址 + 包标识 + 长度 + 指令码/参数 + 校验和
+// 固定指令由 make_command_frame() 在编译期生成, 作为常量存放在 flash;
+// 参数化指令复制模板后只改写可变字段, 末尾校验和随之增量更新。
+// 模板中的地址为 BROADCAST_ADDRESS, 发送前由 write_address() 改写, 校验和不受影响
+template<size_t N> struct CommandFrame {
+  static constexpr size_t SIZE = N;
+  uint8_t data[N];
+
+  constexpr uint8_t cmd() const { return data[CMD_CODE_START_POS]; }
+
+  CommandFrame &set_u8(size_t pos, uint8_t value) {
+    uint16_t sum = (data[N - 2] << 8) | data[N - 1];
+    sum = sum - data[pos] + value;
+    data[pos] = value;
+    data[N - 2] = sum >> 8;
+    data[N - 1] = sum & 0xFF;
+    return *this;
+  }
+  CommandFrame &set_u16(size_t pos, uint16_t value) {
+    set_u8(pos, value >> 8);
+    return set_u8(pos + 1, value & 0xFF);
+  }
+};
+
+// 编译期构建指令帧, BODY 为指令码及参数 (可变参数先填0)
+template<uint8_t... BODY> constexpr CommandFrame<FRAME_HEAD_SIZE + sizeof...(BODY) + 2> make_command_frame() {
+  CommandFrame<FRAME_HEAD_SIZE + sizeof...(BODY) + 2> frame{};
+  const uint8_t body[] = {BODY...};
+  const uint16_t length = sizeof...(BODY) + 2;  // 指令码/参数 + 校验和
+
+  frame.data[0] = FIRST_HEAD;
+  frame.data[1] = SECOND_HEAD;
+  frame.data[2] = (BROADCAST_ADDRESS >> 24) & 0xFF;
+  frame.data[3] = (BROADCAST_ADDRESS >> 16) & 0xFF;
+  frame.data[4] = (BROADCAST_ADDRESS >> 8) & 0xFF;
+  frame.data[5] = BROADCAST_ADDRESS & 0xFF;
+  frame.data[6] = PKG_CMD;
+  frame.data[7] = length >> 8;
+  frame.data[8] = length & 0xFF;
+
+  uint16_t sum = PKG_CMD + (length >> 8) + (length & 0xFF);
+  for (size_t i = 0; i < sizeof...(BODY); i++) {
+    frame.data[CMD_CODE_START_POS + i] = body[i];
+    sum += body[i];
+  }
+  frame.data[CMD_CODE_START_POS + sizeof...(BODY)] = sum >> 8;
+  frame.data[CMD_CODE_START_POS + sizeof...(BODY) + 1] = sum & 0xFF;
+  return frame;
+}
+
+// 帧地址字段读写
+inline uint32_t read_address(const uint8_t *packet) {
+  return (uint32_t(packet[ADDRESS_POS]) << 24) | (uint32_t(packet[ADDRESS_POS + 1]) << 16) |
+         (uint32_t(packet[ADDRESS_POS + 2]) << 8) | packet[ADDRESS_POS + 3];
+}
+inline void write_address(uint8_t *packet, uint32_t address) {
+  packet[ADDRESS_POS] = address >> 24;
+  packet[ADDRESS_POS + 1] = (address >> 16) & 0xFF;
+  packet[ADDRESS_POS + 2] = (address >> 8) & 0xFF;
+  packet[ADDRESS_POS + 3] = address & 0xFF;
+}
+
+// 在 packet + FRAME_HEAD_SIZE 处已写好 length 字节负载的前提下补齐包头和校验和,
+// 用于数据包 (PKG_DATA) 和结束包 (PKG_EOF), 返回整包字节数
+uint16_t finish_data_packet(uint8_t *packet, uint8_t pid, uint16_t length, uint32_t address = BROADCAST_ADDRESS);
+
+// 应答帧增量解析器 (参考 fp_syno_protocol_parse 的状态机)
+// 逐字节喂入, 按长度字段判断帧结束, 帧完整后立即返回, 不再依赖超时
+class FrameParser {
+ public:
+  static const uint16_t MAX_FRAME_SIZE = FRAME_HEAD_SIZE + MAX_DATA_PACKET_SIZE + 2;
+
+  enum Result : uint8_t {
+    FRAME_PENDING,       // 帧未完整
+    FRAME_COMPLETE,      // 收到完整且校验正确的帧
+    FRAME_BAD_CHECKSUM,  // 帧完整但校验和错误, 已丢弃
+  };
+
+  Result feed(uint8_t data);
+  void reset();
+
+  // 仅在 feed() 返回 FRAME_COMPLETE 后有效, 直到下一个包头到来
+  const uint8_t *data() const { return buf_; }
+  uint16_t size() const { return size_; }
+
+ protected:
+  enum State : uint8_t {
+    RCV_FIRST_HEAD,
+    RCV_SECOND_HEAD,
+    RCV_PKG_SIZE,
+    RCV_DATAS,
+  };
+
+  State state_{RCV_FIRST_HEAD};
+  uint8_t buf_[MAX_FRAME_SIZE];
+  uint16_t size_{0};
+  uint16_t pkg_dlen_{0};  // 长度字段: 参数 + 校验和
+  uint16_t sum_{0};       // 边接收边累加的校验和
+};
+
+}  // namespace zw101
+}  // namespace esphome
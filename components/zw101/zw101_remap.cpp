@@ -0,0 +1,86 @@
+#include "zw101_remap.h"
+
+namespace esphome {
+namespace zw101 {
+
+int PageRemap::find(uint16_t page) const {
+  for (uint8_t i = 0; i < count_; i++) {
+    if (entries_[i].page == page)
+      return i;
+  }
+  return -1;
+}
+
+uint16_t PageRemap::id_of(uint16_t page) const {
+  int index = find(page);
+  return index < 0 ? page : entries_[index].id;
+}
+
+// 置换中 ID 集合与页集合相同: ID 不在表中时必然也没有页映射到别处, 即等于页号
+uint16_t PageRemap::page_of(uint16_t id) const {
+  for (uint8_t i = 0; i < count_; i++) {
+    if (entries_[i].id == id)
+      return entries_[i].page;
+  }
+  return id;
+}
+
+bool PageRemap::is_identity(uint16_t start, uint16_t count) const {
+  for (uint8_t i = 0; i < count_; i++) {
+    if (entries_[i].id >= start && entries_[i].id - start < count)
+      return false;
+  }
+  return true;
+}
+
+bool PageRemap::can_swap(uint16_t a, uint16_t b) const {
+  uint16_t id_a = id_of(a);
+  uint16_t id_b = id_of(b);
+  int needed = count_ - (find(a) >= 0) - (find(b) >= 0) + (id_b != a) + (id_a != b);
+  return needed <= MAX_ENTRIES;
+}
+
+bool PageRemap::swap(uint16_t a, uint16_t b) {
+  if (!can_swap(a, b))
+    return false;
+  uint16_t id_a = id_of(a);
+  uint16_t id_b = id_of(b);
+  set(a, id_b);
+  set(b, id_a);
+  return true;
+}
+
+void PageRemap::set(uint16_t page, uint16_t id) {
+  int index = find(page);
+  if (id == page) {
+    if (index >= 0)
+      entries_[index] = entries_[--count_];
+    return;
+  }
+  if (index >= 0) {
+    entries_[index].id = id;
+  } else {
+    entries_[count_++] = {page, id};
+  }
+}
+
+void PageRemap::clear() {
+  count_ = 0;
+  move_state_ = MOVE_NONE;
+}
+
+void PageRemap::begin_move(uint16_t src, uint16_t dst) {
+  move_state_ = MOVE_COPYING;
+  move_src_ = src;
+  move_dst_ = dst;
+}
+
+bool PageRemap::finish_copy() {
+  if (move_state_ != MOVE_COPYING || !swap(move_src_, move_dst_))
+    return false;
+  move_state_ = MOVE_DELETING;
+  return true;
+}
+
+}  // namespace zw101
+}  // namespace esphome
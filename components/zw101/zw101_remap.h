@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+
+namespace esphome {
+namespace zw101 {
+
+// 指纹库重排后的 ID 映射: 对外发布的 ID (match_id、注册和删除用的 ID) 与模板实际所在页的对应关系,
+// 以及进行中搬移的日志。映射是整个页空间上的置换, 空页同样有 ID, 只记录 ID 与页号不同的页;
+// 整个对象作为一条偏好设置保存, 改动后立即写入 flash
+class PageRemap {
+ public:
+  static const uint8_t MAX_ENTRIES = 32;
+
+  // 搬移日志: 模板从 src 复制到空页 dst 后交换两页的 ID, 再删除 src;
+  // 复制前记为 MOVE_COPYING, 交换 ID 与 MOVE_DELETING 在同一次保存中生效
+  enum MoveState : uint8_t {
+    MOVE_NONE,
+    MOVE_COPYING,   // 重启后 dst 已占用则视为复制完成, 否则放弃本次搬移
+    MOVE_DELETING,  // ID 已交换, src 上是多余的副本
+  };
+
+  uint16_t id_of(uint16_t page) const;  // 页上模板的 ID
+  uint16_t page_of(uint16_t id) const;  // ID 所在的页
+  bool is_identity(uint16_t start, uint16_t count) const;  // [start, start + count) 的 ID 都等于页号
+  uint8_t size() const { return count_; }
+
+  // 交换两页的 ID; 映射表放不下时返回 false, 不做改动
+  bool can_swap(uint16_t a, uint16_t b) const;
+  bool swap(uint16_t a, uint16_t b);
+  void clear();
+
+  MoveState move_state() const { return static_cast<MoveState>(move_state_); }
+  uint16_t move_src() const { return move_src_; }
+  uint16_t move_dst() const { return move_dst_; }
+  void begin_move(uint16_t src, uint16_t dst);
+  bool finish_copy();  // 交换 src 与 dst 的 ID, 进入 MOVE_DELETING
+  void end_move() { move_state_ = MOVE_NONE; }
+
+ protected:
+  struct Entry {
+    uint16_t page;
+    uint16_t id;
+  };
+
+  int find(uint16_t page) const;
+  void set(uint16_t page, uint16_t id);
+
+  Entry entries_[MAX_ENTRIES]{};
+  uint8_t count_{0};
+  uint8_t move_state_{MOVE_NONE};
+  uint16_t move_src_{0};
+  uint16_t move_dst_{0};
+};
+
+}  // namespace zw101
+}  // namespace esphome
@@ -0,0 +1,98 @@
+#include "zw101_stats.h"
+
+namespace esphome {
+namespace zw101 {
+
+const uint32_t CommandLatency::BUCKET_LIMITS_US[BUCKETS] = {
+    5000, 10000, 20000, 50000, 100000, 200000, 500000, 1000000, 2000000, UINT32_MAX,
+};
+
+uint32_t CommandLatency::percentile_us(uint8_t percent) const {
+  if (count == 0)
+    return 0;
+
+  uint32_t target = (static_cast<uint64_t>(count) * percent + 99) / 100;  // 第 target 个样本
+  uint32_t seen = 0;
+  for (uint8_t i = 0; i < BUCKETS; i++) {
+    if (seen + buckets[i] < target) {
+      seen += buckets[i];
+      continue;
+    }
+    uint32_t low = i == 0 ? 0 : BUCKET_LIMITS_US[i - 1];
+    uint32_t high = i == BUCKETS - 1 ? max_us : BUCKET_LIMITS_US[i];
+    if (low < min_us)
+      low = min_us;
+    if (high > max_us)
+      high = max_us;
+    if (high <= low)
+      return low;
+    return low + static_cast<uint64_t>(high - low) * (target - seen) / buckets[i];
+  }
+  return max_us;
+}
+
+uint32_t CommandLatency::statistic_us(LatencyStatistic statistic) const {
+  switch (statistic) {
+    case LATENCY_MIN:
+      return min_us;
+    case LATENCY_P95:
+      return percentile_us(95);
+    case LATENCY_MAX:
+      return max_us;
+    case LATENCY_AVG:
+    default:
+      return avg_us();
+  }
+}
+
+CommandLatency *CommandStats::entry(uint8_t cmd) {
+  for (uint8_t i = 0; i < size_; i++) {
+    if (entries_[i].cmd == cmd)
+      return &entries_[i];
+  }
+  if (size_ >= MAX_COMMANDS)
+    return nullptr;
+
+  CommandLatency &latency = entries_[size_++];
+  latency = CommandLatency();
+  latency.cmd = cmd;
+  return &latency;
+}
+
+const CommandLatency *CommandStats::find(uint8_t cmd) const {
+  for (uint8_t i = 0; i < size_; i++) {
+    if (entries_[i].cmd == cmd)
+      return &entries_[i];
+  }
+  return nullptr;
+}
+
+void CommandStats::record(uint8_t cmd, uint32_t wait_us, uint32_t round_trip_us) {
+  CommandLatency *latency = entry(cmd);
+  if (latency == nullptr)
+    return;
+
+  if (latency->count == 0 || round_trip_us < latency->min_us)
+    latency->min_us = round_trip_us;
+  if (round_trip_us > latency->max_us)
+    latency->max_us = round_trip_us;
+  latency->count++;
+  latency->total_us += round_trip_us;
+  latency->total_wait_us += wait_us;
+
+  uint8_t bucket = 0;
+  while (bucket < CommandLatency::BUCKETS - 1 && round_trip_us > CommandLatency::BUCKET_LIMITS_US[bucket])
+    bucket++;
+  latency->buckets[bucket]++;
+}
+
+void CommandStats::record_timeout(uint8_t cmd, uint32_t wait_us) {
+  CommandLatency *latency = entry(cmd);
+  if (latency == nullptr)
+    return;
+  latency->timeouts++;
+  latency->total_wait_us += wait_us;
+}
+
+}  // namespace zw101
+}  // namespace esphome
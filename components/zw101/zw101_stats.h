@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace zw101 {
+
+// 延迟统计量, 供诊断传感器选择
+enum LatencyStatistic : uint8_t {
+  LATENCY_MIN,
+  LATENCY_AVG,
+  LATENCY_P95,
+  LATENCY_MAX,
+};
+
+// 单条指令的往返延迟统计 (微秒)
+// 往返 = 指令写入串口到完整应答解析出来, 包含线上传输、模组处理和本地 loop 调度
+// 排队 = 入队到写入串口, 反映本地队列和 loop 间隔
+struct CommandLatency {
+  static const uint8_t BUCKETS = 10;
+  static const uint32_t BUCKET_LIMITS_US[BUCKETS];  // 各桶上限, 最后一桶不封顶
+
+  uint8_t cmd{0};
+  uint32_t count{0};     // 收到应答的次数
+  uint32_t timeouts{0};  // 超时次数, 不计入延迟
+  uint32_t min_us{0};
+  uint32_t max_us{0};
+  uint64_t total_us{0};
+  uint64_t total_wait_us{0};
+  uint32_t buckets[BUCKETS]{};
+
+  uint32_t avg_us() const { return count ? total_us / count : 0; }
+  uint32_t avg_wait_us() const { return (count + timeouts) ? total_wait_us / (count + timeouts) : 0; }
+  // 由直方图估算百分位: 落入的桶内线性插值, 并限制在 [min, max]
+  uint32_t percentile_us(uint8_t percent) const;
+  uint32_t statistic_us(LatencyStatistic statistic) const;
+};
+
+// 按指令码索引的固定大小统计表, 不做动态分配; 表满后新指令不再统计
+class CommandStats {
+ public:
+  static const uint8_t MAX_COMMANDS = 16;
+
+  void record(uint8_t cmd, uint32_t wait_us, uint32_t round_trip_us);
+  void record_timeout(uint8_t cmd, uint32_t wait_us);
+  void reset() { size_ = 0; }
+
+  const CommandLatency *find(uint8_t cmd) const;
+  uint8_t size() const { return size_; }
+  const CommandLatency &at(uint8_t index) const { return entries_[index]; }
+
+ protected:
+  CommandLatency *entry(uint8_t cmd);
+
+  CommandLatency entries_[MAX_COMMANDS];
+  uint8_t size_{0};
+};
+
+}  // namespace zw101
+}  // namespace esphome
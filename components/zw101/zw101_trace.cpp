@@ -0,0 +1,90 @@
+#include "zw101_trace.h"
+#include "zw101_protocol.h"
+#include "esphome/core/hal.h"
+
+#include <cstring>
+
+namespace esphome {
+namespace zw101 {
+
+void FrameTrace::set_capacity(size_t capacity) {
+  // 至少容纳一条最长的记录
+  if (capacity != 0 && capacity < HEADER_SIZE + MAX_RECORD_BYTES)
+    capacity = HEADER_SIZE + MAX_RECORD_BYTES;
+  buf_.reset(capacity != 0 ? new uint8_t[capacity] : nullptr);
+  capacity_ = capacity;
+  clear();
+}
+
+void FrameTrace::clear() {
+  head_ = 0;
+  tail_ = 0;
+  used_ = 0;
+  count_ = 0;
+  overwritten_ = 0;
+}
+
+void FrameTrace::append(Direction direction, const uint8_t *data, uint16_t length) {
+  // 数据包只保存包头, 不把模板内容留在内存和日志里
+  uint16_t stored = length < MAX_RECORD_BYTES ? length : MAX_RECORD_BYTES;
+  if (length > FRAME_HEAD_SIZE && (data[6] == PKG_DATA || data[6] == PKG_EOF))
+    stored = FRAME_HEAD_SIZE;
+  size_t size = HEADER_SIZE + stored;
+
+  // 覆盖最旧的记录直到放得下
+  while (capacity_ - used_ < size) {
+    uint8_t old_stored;
+    read((tail_ + HEADER_SIZE - 1) % capacity_, &old_stored, 1);
+    size_t old_size = HEADER_SIZE + old_stored;
+    tail_ = (tail_ + old_size) % capacity_;
+    used_ -= old_size;
+    count_--;
+    overwritten_++;
+  }
+
+  uint32_t time_us = micros();
+  uint8_t header[HEADER_SIZE] = {
+      static_cast<uint8_t>(time_us >> 24), static_cast<uint8_t>(time_us >> 16),
+      static_cast<uint8_t>(time_us >> 8),  static_cast<uint8_t>(time_us),
+      direction,                           static_cast<uint8_t>(length >> 8),
+      static_cast<uint8_t>(length),        static_cast<uint8_t>(stored),
+  };
+  write(header, HEADER_SIZE);
+  write(data, stored);
+  count_++;
+}
+
+void FrameTrace::write(const uint8_t *data, size_t size) {
+  size_t first = capacity_ - head_ < size ? capacity_ - head_ : size;
+  memcpy(buf_.get() + head_, data, first);
+  memcpy(buf_.get(), data + first, size - first);
+  head_ = (head_ + size) % capacity_;
+  used_ += size;
+}
+
+void FrameTrace::read(size_t pos, uint8_t *data, size_t size) const {
+  size_t first = capacity_ - pos < size ? capacity_ - pos : size;
+  memcpy(data, buf_.get() + pos, first);
+  memcpy(data + first, buf_.get(), size - first);
+}
+
+void FrameTrace::for_each(const Visitor &visitor) const {
+  size_t pos = tail_;
+  for (uint32_t i = 0; i < count_; i++) {
+    uint8_t header[HEADER_SIZE];
+    uint8_t data[MAX_RECORD_BYTES];
+    read(pos, header, HEADER_SIZE);
+    Record record;
+    record.time_us = (static_cast<uint32_t>(header[0]) << 24) | (static_cast<uint32_t>(header[1]) << 16) |
+                     (static_cast<uint32_t>(header[2]) << 8) | header[3];
+    record.direction = static_cast<Direction>(header[4]);
+    record.length = (header[5] << 8) | header[6];
+    record.stored = header[7];
+    read((pos + HEADER_SIZE) % capacity_, data, record.stored);
+    visitor(record, data);
+    pos = (pos + HEADER_SIZE + record.stored) % capacity_;
+  }
+}
+
+}  // namespace zw101
+}  // namespace esphome
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace esphome {
+namespace zw101 {
+
+// 串口收发跟踪: 以二进制记录每一帧的时间戳、方向和原始字节, 存入固定大小的环形缓冲区,
+// 写满后覆盖最旧的记录。容量为0时不分配内存, record() 只有一次判断
+// 记录格式: 时间(4, 微秒) 方向(1) 原始帧长(2) 保存字节数(1) 数据(保存字节数)
+class FrameTrace {
+ public:
+  enum Direction : uint8_t {
+    TRACE_TX,            // 发往模组
+    TRACE_RX,            // 来自模组, 校验正确
+    TRACE_TIMEOUT,       // 指令超时, 数据为指令码
+    TRACE_BAD_CHECKSUM,  // 收到校验和错误的帧, 无数据
+  };
+
+  static const uint8_t HEADER_SIZE = 8;
+  static const uint8_t MAX_RECORD_BYTES = 48;  // 每帧最多保存的字节数, 更长的帧截断
+
+  struct Record {
+    uint32_t time_us;
+    Direction direction;
+    uint16_t length;  // 原始帧长
+    uint8_t stored;   // 实际保存的字节数
+  };
+  using Visitor = std::function<void(const Record &record, const uint8_t *data)>;
+
+  // 设置缓冲区字节数并清空已有记录, 0 表示关闭跟踪
+  void set_capacity(size_t capacity);
+  size_t get_capacity() const { return capacity_; }
+  bool enabled() const { return capacity_ != 0; }
+
+  void record(Direction direction, const uint8_t *data, uint16_t length) {
+    if (capacity_ != 0)
+      append(direction, data, length);
+  }
+  void clear();
+
+  // 从最旧到最新遍历
+  void for_each(const Visitor &visitor) const;
+  uint32_t count() const { return count_; }
+  uint32_t overwritten() const { return overwritten_; }
+
+ protected:
+  void append(Direction direction, const uint8_t *data, uint16_t length);
+  void write(const uint8_t *data, size_t size);
+  void read(size_t pos, uint8_t *data, size_t size) const;
+
+  std::unique_ptr<uint8_t[]> buf_;
+  size_t capacity_{0};
+  size_t head_{0};  // 下一条记录写入位置
+  size_t tail_{0};  // 最旧记录位置
+  size_t used_{0};
+  uint32_t count_{0};        // 缓冲区中的记录数
+  uint32_t overwritten_{0};  // 因缓冲区写满被覆盖的记录数
+};
+
+}  // namespace zw101
+}  // namespace esphome
@@ -0,0 +1,1218 @@
+// ZW101 组件主机基准测试
+// 在 Linux 上用虚拟串口 + 模组仿真器运行 ZW101Component, 测量:
+// - 解锁延迟: 手指按下到 binary_sensor 变为 ON 的时间
+// - 双读头解锁延迟: 同一主循环驱动两个读头、两个手指几乎同时按下时各自的解锁延迟,
+//   以及两个模组按地址共用一个串口时的解锁延迟
+// - 改写模组地址: 改为新地址后能否继续通信
+// - 批量操作: 逐个删除与合并区间删除的耗时和指令数, 指纹库核对与批量下载
+// - 自动验证解锁延迟: 模组自行完成采图和搜索时, 按下到上报的时间和主机发出的指令数
+// - 注册耗时: 手动注册与自动注册 (PS_AutoEnroll) 从开始到存储完成的时间和主机指令数, 自动注册中途排队的指令是否正常完成
+// - 自动注册查重: PS_AutoEnroll 参数 bit4 是否决定查重, 组件自动注册已注册的手指时是否报告重复
+// - 指令吞吐: 每秒完成的握手指令数
+// - 连续解锁延迟: 刚解锁过一次后再次按压的检测速度
+// - 手指按住不放: 一次按压期间上报的匹配次数和发给模组的指令数
+// - 空闲流量: 无手指时每秒发给模组的指令数
+// - 休眠唤醒: 不同空闲休眠时间下, 按压时的唤醒耗时、解锁延迟和模组休眠时间占比
+// - 灯控合并: 连续和重复的灯控请求实际发出的帧数, 搜索期间改灯是否影响解锁, 改灯后立即进入自动验证时灯控是否发出
+// - 指令延迟: 组件自带统计表中各指令的往返延迟
+// - 稀疏指纹库: 1000 页容量、少量分散模板时的解锁延迟和搜索页数
+// - 候选优先比对: 1000 页全满、常用用户注册在靠后的页时, 先 1:1 比对常用页与直接 1:N 搜索的解锁延迟和命中率
+// - 指纹库重排: 常用用户注册在靠后的页时, 空闲重排前后的解锁延迟和 match_id 是否不变, 超出容量的删除是否被拒绝,
+//   搬移各阶段断电重启后模板是否完整, 以及两个出厂地址的读头各自的 ID 映射重启后能否读回
+// - 模板备份/恢复: 上传一个模板并下载到另一页的耗时, 以及数据是否完整; 上传中一包数据校验失败时应报告失败
+// - 波特率升级: 57600 启动后切换到 115200 的耗时, 以及模组断电重启回到 57600 后的恢复时间
+// 解锁延迟和空闲流量分别在轮询模式和触摸唤醒模式下测量
+//
+// 用法: zw101_bench [-l loop_interval_ms] [-b baud_rate] [-v]
+
+#include "sim_clock.h"
+#include "virtual_uart.h"
+#include "zw101.h"
+#include "zw101_sim.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <vector>
+
+using esphome::zw101::ZW101Component;
+using zw101_sim::ModuleSimulator;
+using zw101_sim::SimClock;
+using zw101_sim::VirtualUART;
+
+namespace {
+
+const uint64_t SIM_TICK_US = 50;  // 仿真步长
+
+struct BenchConfig {
+  uint32_t loop_interval_us{16000};  // ESPHome 默认主循环间隔 16ms
+  uint32_t baud_rate{57600};
+  bool touch_wake{false};  // 接入模组 TOUCH_OUT 引脚
+};
+
+// 一个读头: 虚拟串口、模组仿真器、组件及其传感器
+struct Reader {
+  explicit Reader(const BenchConfig &config) : module(&uart) {
+    uart.set_baud_rate(config.baud_rate);
+    uart.set_module_baud_rate(config.baud_rate);
+    component.set_uart_parent(&uart);
+    component.set_fingerprint_sensor(&match_sensor);
+    component.set_match_id_sensor(&match_id);
+    component.set_match_score_sensor(&match_score);
+    component.set_status_sensor(&status);
+    component.set_search_pages_sensor(&search_pages);
+    if (config.touch_wake)
+      component.set_touch_pin(module.touch_pin());
+  }
+
+  VirtualUART uart;
+  ModuleSimulator module;
+  ZW101Component component;
+  esphome::binary_sensor::BinarySensor match_sensor;
+  esphome::sensor::Sensor match_id;
+  esphome::sensor::Sensor match_score;
+  esphome::sensor::Sensor search_pages;
+  esphome::text_sensor::TextSensor status;
+};
+
+// 一套完整的被测环境: 一个或多个读头共用一个主循环, 与 ESPHome 依次调用各组件的 loop() 一致
+struct Bench : Reader {
+  explicit Bench(const BenchConfig &config, size_t extra_readers = 0) : Reader(config), config(config) {
+    SimClock::reset();
+    esphome::global_preferences->reset();
+    for (size_t i = 0; i < extra_readers; i++)
+      extra.emplace_back(new Reader(config));
+  }
+
+  Reader &reader(size_t index) { return index == 0 ? *this : *extra[index - 1]; }
+  size_t reader_count() const { return extra.size() + 1; }
+
+  void setup() {
+    for (size_t i = 0; i < reader_count(); i++)
+      reader(i).component.setup();
+  }
+
+  // 推进仿真时间: 模组每个步长都运行, 组件按主循环间隔运行
+  void run_until_us(uint64_t end_us) {
+    while (SimClock::now_us() < end_us) {
+      if (SimClock::now_us() >= next_loop_us) {
+        for (size_t i = 0; i < reader_count(); i++)
+          reader(i).component.loop();
+        next_loop_us = SimClock::now_us() + config.loop_interval_us;
+      }
+      for (size_t i = 0; i < reader_count(); i++)
+        reader(i).module.poll();
+      SimClock::advance_us(SIM_TICK_US);
+    }
+  }
+  void run_for_ms(uint64_t ms) { run_until_us(SimClock::now_us() + ms * 1000); }
+
+  BenchConfig config;
+  std::vector<std::unique_ptr<Reader>> extra;
+  uint64_t next_loop_us{0};
+};
+
+struct Stats {
+  std::vector<double> samples;
+  void add(double value) { samples.push_back(value); }
+  double mean() const {
+    double sum = 0;
+    for (double v : samples)
+      sum += v;
+    return samples.empty() ? 0 : sum / samples.size();
+  }
+  void print(const char *label, const char *unit) {
+    if (samples.empty()) {
+      printf("  %-28s no samples\n", label);
+      return;
+    }
+    std::sort(samples.begin(), samples.end());
+    printf("  %-28s n=%-3zu min=%7.1f avg=%7.1f p50=%7.1f max=%7.1f %s\n", label, samples.size(), samples.front(),
+           mean(), samples[samples.size() / 2], samples.back(), unit);
+  }
+};
+
+// 解锁延迟: 已注册手指在不同相位按下, 统计到匹配上报的时间
+void bench_unlock_latency(const BenchConfig &config) {
+  const int trials = 10;
+  Stats latency;
+  int misses = 0;
+
+  for (int i = 0; i < trials; i++) {
+    Bench bench(config);
+    bench.module.enroll(3, 1001);
+    bench.component.setup();
+    bench.run_for_ms(3000);
+
+    // 按下时刻错开, 覆盖轮询周期内的不同相位
+    uint64_t press_ms = SimClock::now_us() / 1000 + 137 * i;
+    bench.module.add_touch(press_ms, press_ms + 2500, 1001);
+    bench.run_until_us(press_ms * 1000);
+
+    uint64_t deadline = SimClock::now_us() + 5000000;
+    while (!bench.match_sensor.state && SimClock::now_us() < deadline)
+      bench.run_until_us(SimClock::now_us() + SIM_TICK_US);
+
+    if (bench.match_sensor.state) {
+      latency.add((SimClock::now_us() - press_ms * 1000) / 1000.0);
+    } else {
+      misses++;
+    }
+  }
+
+  latency.print(config.touch_wake ? "unlock latency (touch)" : "unlock latency (poll)", "ms");
+  if (misses)
+    printf("  %-28s %d/%d\n", "missed unlocks", misses, trials);
+}
+
+// 双读头解锁延迟: 进门、出门两个读头各接一个串口, 由同一主循环驱动;
+// 两个手指几乎同时按下, 各读头的延迟应与单读头一致
+void bench_dual_reader_latency(const BenchConfig &config) {
+  const int trials = 10;
+  Stats latency[2];
+  int misses = 0;
+
+  for (int i = 0; i < trials; i++) {
+    Bench bench(config, 1);
+    bench.reader(0).module.enroll(3, 1001);
+    bench.reader(1).module.enroll(7, 2002);
+    bench.setup();
+    bench.run_for_ms(3000);
+
+    // 第二个读头晚 0~90ms 按下, 覆盖两个读头收发交错的各种情况
+    uint64_t press_us[2];
+    press_us[0] = (SimClock::now_us() / 1000 + 137 * i) * 1000;
+    press_us[1] = press_us[0] + (i % 4) * 30000;
+    bench.reader(0).module.add_touch(press_us[0] / 1000, press_us[0] / 1000 + 2500, 1001);
+    bench.reader(1).module.add_touch(press_us[1] / 1000, press_us[1] / 1000 + 2500, 2002);
+    bench.run_until_us(press_us[0]);
+
+    uint64_t matched_us[2] = {0, 0};
+    uint64_t deadline = SimClock::now_us() + 5000000;
+    while ((matched_us[0] == 0 || matched_us[1] == 0) && SimClock::now_us() < deadline) {
+      bench.run_until_us(SimClock::now_us() + SIM_TICK_US);
+      for (int r = 0; r < 2; r++) {
+        if (matched_us[r] == 0 && bench.reader(r).match_sensor.state)
+          matched_us[r] = SimClock::now_us();
+      }
+    }
+
+    for (int r = 0; r < 2; r++) {
+      if (matched_us[r] != 0) {
+        latency[r].add((matched_us[r] - press_us[r]) / 1000.0);
+      } else {
+        misses++;
+      }
+    }
+  }
+
+  const char *suffix = config.touch_wake ? "(touch)" : "(poll)";
+  char label[40];
+  for (int r = 0; r < 2; r++) {
+    snprintf(label, sizeof(label), "dual reader %c %s", 'A' + r, suffix);
+    latency[r].print(label, "ms");
+  }
+  if (misses)
+    printf("  %-28s %d/%d\n", "missed unlocks", misses, trials * 2);
+}
+
+// 共享总线解锁延迟: 两个模组经收发器接在同一个串口上, 按地址区分;
+// 指令在总线上轮流发送, 同时按下时后发的一方多等一次对方的指令
+void bench_shared_bus_latency(const BenchConfig &config) {
+  const int trials = 10;
+  const uint32_t addresses[2] = {0x00000001, 0x00000002};
+  Stats latency[2];
+  int misses = 0;
+
+  for (int i = 0; i < trials; i++) {
+    SimClock::reset();
+    VirtualUART uart;
+    uart.set_baud_rate(config.baud_rate);
+    uart.set_module_baud_rate(config.baud_rate);
+    ModuleSimulator module_a(&uart);
+    ModuleSimulator module_b(&uart, uart.add_module_tap());
+    ModuleSimulator *modules[2] = {&module_a, &module_b};
+    ZW101Component components[2];
+    esphome::binary_sensor::BinarySensor match_sensors[2];
+    for (int r = 0; r < 2; r++) {
+      modules[r]->set_address(addresses[r]);
+      modules[r]->enroll(3 + r, 1001 + r);
+      components[r].set_uart_parent(&uart);
+      components[r].set_address(addresses[r]);
+      components[r].set_fingerprint_sensor(&match_sensors[r]);
+      if (config.touch_wake)
+        components[r].set_touch_pin(modules[r]->touch_pin());
+      components[r].setup();
+    }
+
+    uint64_t next_loop_us = 0;
+    auto run_until_us = [&](uint64_t end_us) {
+      while (SimClock::now_us() < end_us) {
+        if (SimClock::now_us() >= next_loop_us) {
+          components[0].loop();
+          components[1].loop();
+          next_loop_us = SimClock::now_us() + config.loop_interval_us;
+        }
+        module_a.poll();
+        module_b.poll();
+        SimClock::advance_us(SIM_TICK_US);
+      }
+    };
+    run_until_us(3000000);
+
+    uint64_t press_us[2];
+    press_us[0] = (SimClock::now_us() / 1000 + 137 * i) * 1000;
+    press_us[1] = press_us[0] + (i % 4) * 30000;
+    for (int r = 0; r < 2; r++)
+      modules[r]->add_touch(press_us[r] / 1000, press_us[r] / 1000 + 2500, 1001 + r);
+    run_until_us(press_us[0]);
+
+    uint64_t matched_us[2] = {0, 0};
+    uint64_t deadline = SimClock::now_us() + 5000000;
+    while ((matched_us[0] == 0 || matched_us[1] == 0) && SimClock::now_us() < deadline) {
+      run_until_us(SimClock::now_us() + SIM_TICK_US);
+      for (int r = 0; r < 2; r++) {
+        if (matched_us[r] == 0 && match_sensors[r].state)
+          matched_us[r] = SimClock::now_us();
+      }
+    }
+
+    for (int r = 0; r < 2; r++) {
+      if (matched_us[r] != 0) {
+        latency[r].add((matched_us[r] - press_us[r]) / 1000.0);
+      } else {
+        misses++;
+      }
+    }
+  }
+
+  const char *suffix = config.touch_wake ? "(touch)" : "(poll)";
+  char label[40];
+  for (int r = 0; r < 2; r++) {
+    snprintf(label, sizeof(label), "shared bus %c %s", 'A' + r, suffix);
+    latency[r].print(label, "ms");
+  }
+  if (misses)
+    printf("  %-28s %d/%d\n", "missed unlocks", misses, trials * 2);
+}
+
+// 改写模组地址: 出厂地址的模组改为新地址后, 用新地址通信
+void bench_set_address(const BenchConfig &config) {
+  Bench bench(config);
+  bench.component.setup();
+  bench.run_for_ms(1000);
+
+  bool changed = false;
+  bool online = false;
+  bench.component.set_module_address(0x12345678, [&](bool ok) { changed = ok; });
+  bench.run_for_ms(500);
+  bench.component.handshake([&](bool ok) { online = ok; });
+  bench.run_for_ms(500);
+  printf("  %-28s %s (module 0x%08X, handshake %s)\n", "set module address", changed ? "ok" : "failed",
+         (unsigned) bench.module.get_address(), online ? "ok" : "failed");
+}
+
+// 自动验证解锁延迟: 主机只启动 PS_AutoIdentify, 每次出结果后重新启动
+void bench_auto_match_latency(const BenchConfig &config) {
+  const int trials = 10;
+  Stats latency;
+  Stats commands;
+  int misses = 0;
+  int rejected = 0;
+
+  for (int i = 0; i < trials; i++) {
+    Bench bench(config);
+    bench.module.enroll(3, 1001);
+    bench.component.setup();
+    bench.run_for_ms(1000);
+    bench.component.auto_match_mode();
+    bench.run_for_ms(2000);
+    // 模组拒绝自动验证指令时组件退回主机轮询, 延迟仍能测出, 需单独报告
+    if (bench.status.state == "Auto Match Failed")
+      rejected++;
+
+    uint64_t press_ms = SimClock::now_us() / 1000 + 137 * i;
+    bench.module.add_touch(press_ms, press_ms + 200, 1001);
+    bench.run_until_us(press_ms * 1000);
+    uint32_t before = bench.module.total_commands();
+
+    uint64_t deadline = SimClock::now_us() + 5000000;
+    while (!bench.match_sensor.state && SimClock::now_us() < deadline)
+      bench.run_until_us(SimClock::now_us() + SIM_TICK_US);
+
+    if (bench.match_sensor.state) {
+      latency.add((SimClock::now_us() - press_ms * 1000) / 1000.0);
+      commands.add(bench.module.total_commands() - before);
+    } else {
+      misses++;
+    }
+  }
+
+  latency.print("unlock latency (auto match)", "ms");
+  commands.print("host commands per unlock", "cmd");
+  if (misses)
+    printf("  %-28s %d/%d\n", "missed unlocks", misses, trials);
+  if (rejected)
+    printf("  %-28s %d/%d\n", "auto match rejected", rejected, trials);
+}
+
+// 注册耗时: 同一按压节奏 (按下 500ms, 周期 1200ms) 下比较手动注册和自动注册;
+// 手动注册采集后固定等待1秒再轮询, 会错过部分按压; 自动注册中途查询模板数, 查询应在注册结束后得到应答
+void bench_enrollment(const BenchConfig &config) {
+  for (bool automatic : {false, true}) {
+    Bench bench(config);
+    bench.module.enroll(0, 1001);
+    bench.component.setup();
+    bench.run_for_ms(1000);
+
+    uint64_t start_us = SimClock::now_us();
+    for (int i = 0; i < 12; i++) {
+      uint64_t press_ms = start_us / 1000 + 500 + i * 1200;
+      bench.module.add_touch(press_ms, press_ms + 500, 2002);
+    }
+    uint32_t before = bench.module.total_commands();
+    if (automatic) {
+      bench.component.auto_enroll_mode(30);
+    } else {
+      bench.component.register_fingerprint();
+    }
+
+    // 自动注册进行中查询模板数: 查询应等注册结束后发出, 应答不能被当作注册阶段
+    int query = -1;
+    bool query_before_store = false;
+    if (automatic) {
+      bench.run_for_ms(2000);
+      bench.component.read_valid_template_count([&](bool ok) {
+        query = ok;
+        query_before_store = !bench.component.get_template_index().is_used(1);
+      });
+    }
+
+    uint64_t deadline = SimClock::now_us() + 20000000;
+    while (!bench.component.get_template_index().is_used(1) && SimClock::now_us() < deadline)
+      bench.run_until_us(SimClock::now_us() + SIM_TICK_US);
+    uint64_t done_us = SimClock::now_us();
+    uint32_t commands = bench.module.total_commands() - before;
+    bench.run_for_ms(500);
+
+    const char *label = automatic ? "auto enroll" : "manual enroll";
+    if (bench.component.get_template_index().is_used(1)) {
+      printf("  %-28s %.1f ms, %u host commands%s\n", label, (done_us - start_us) / 1000.0, commands,
+             !automatic                               ? ""
+             : query == 1 && !query_before_store      ? ", queued query answered after store"
+             : query == 1                             ? ", queued query answered DURING enroll"
+                                                      : ", queued query FAILED");
+    } else {
+      printf("  %-28s not stored (%s)\n", label, bench.status.state.c_str());
+    }
+  }
+}
+
+// 自动注册查重: 已注册手指 (0 页) 再次自动注册到 5 页; 直接向模组发 PS_AutoEnroll 时参数 bit4 决定是否查重
+// (0x0010 拒绝重复, 0x0000 照常存入), 组件发起的自动注册应报告重复
+void bench_auto_enroll_duplicate(const BenchConfig &config) {
+  auto touches = [](Bench &bench) {
+    uint64_t start_ms = SimClock::now_us() / 1000;
+    for (int i = 0; i < 5; i++)
+      bench.module.add_touch(start_ms + 500 + i * 1200, start_ms + 1000 + i * 1200, 1001);
+  };
+
+  for (uint8_t param : {0x10, 0x00}) {
+    Bench bench(config);
+    bench.module.enroll(0, 1001);
+    auto frame = esphome::zw101::make_command_frame<0x31, 0x00, 0x05, 0x05, 0x00, 0x00>();  // 5 页, 5 次
+    frame.set_u8(14, param);
+    bench.uart.write_array(frame.data, frame.SIZE);
+    touches(bench);
+    uint64_t end_us = SimClock::now_us() + 8000000;
+    while (SimClock::now_us() < end_us) {
+      bench.module.poll();
+      SimClock::advance_us(SIM_TICK_US);
+    }
+    bool stored = bench.module.library().count(5) > 0;
+    printf("  %-28s %s\n", param ? "module, param 0x0010" : "module, param 0x0000",
+           stored ? "duplicate stored" : "duplicate rejected");
+  }
+
+  Bench bench(config);
+  bench.module.enroll(0, 1001);
+  bench.component.setup();
+  bench.run_for_ms(1000);
+  bench.component.auto_enroll_mode(30);
+  touches(bench);
+  // 结果状态以 "Enroll " 开头 (进行中为 "Enrolling n/5"); 之后恢复的搜索会改写状态
+  uint64_t deadline = SimClock::now_us() + 8000000;
+  while (bench.status.state.rfind("Enroll ", 0) != 0 && SimClock::now_us() < deadline)
+    bench.run_until_us(SimClock::now_us() + SIM_TICK_US);
+  printf("  %-28s %s\n", "component auto enroll", bench.status.state.c_str());
+}
+
+// 指令吞吐: 关闭自动搜索, 持续保持队列非空, 统计每秒完成的握手数
+void bench_command_throughput(const BenchConfig &config) {
+  Bench bench(config);
+  bench.component.setup();
+  bench.component.disable_auto_search();
+  bench.run_for_ms(1000);
+
+  uint32_t completed = 0;
+  uint64_t start = SimClock::now_us();
+  uint64_t end = start + 5000000;
+  while (SimClock::now_us() < end) {
+    while (bench.component.pending_command_count() < 4) {
+      bench.component.handshake([&completed](bool ok) {
+        if (ok)
+          completed++;
+      });
+    }
+    bench.run_until_us(SimClock::now_us() + SIM_TICK_US);
+  }
+
+  double seconds = (SimClock::now_us() - start) / 1e6;
+  printf("  %-28s %.1f cmd/s (%llu bytes tx, %llu bytes rx)\n", "handshake throughput", completed / seconds,
+         (unsigned long long) bench.uart.bytes_to_module(), (unsigned long long) bench.uart.bytes_to_host());
+}
+
+// 连续解锁: 第一次解锁后手指离开, 匹配状态清除后再次按压, 统计第二次的延迟
+// 反映刚有活动时的检测速度 (门口高峰期)
+void bench_repeat_unlock_latency(const BenchConfig &config) {
+  const int trials = 10;
+  Stats latency;
+
+  for (int i = 0; i < trials; i++) {
+    Bench bench(config);
+    bench.module.enroll(3, 1001);
+    bench.component.setup();
+    bench.run_for_ms(3000);
+
+    uint64_t first_ms = SimClock::now_us() / 1000;
+    bench.module.add_touch(first_ms, first_ms + 800, 1001);
+
+    // 等第一次匹配上报并清除后, 错开相位再次按压
+    bench.run_for_ms(1000);
+    while (bench.match_sensor.state)
+      bench.run_until_us(SimClock::now_us() + SIM_TICK_US);
+    uint64_t press_ms = SimClock::now_us() / 1000 + 97 * i;
+    bench.module.add_touch(press_ms, press_ms + 2500, 1001);
+    bench.run_until_us(press_ms * 1000);
+
+    uint64_t deadline = SimClock::now_us() + 5000000;
+    while (!bench.match_sensor.state && SimClock::now_us() < deadline)
+      bench.run_until_us(SimClock::now_us() + SIM_TICK_US);
+    if (bench.match_sensor.state)
+      latency.add((SimClock::now_us() - press_ms * 1000) / 1000.0);
+  }
+
+  latency.print(config.touch_wake ? "repeat unlock (touch)" : "repeat unlock (poll)", "ms");
+}
+
+// 手指按住不放: 按住6秒, 出结果后应只做在位探测, 不再重复提取特征、搜索和上报匹配
+void bench_held_finger(const BenchConfig &config, bool auto_match) {
+  const uint64_t hold_ms = 6000;
+  Bench bench(config);
+  bench.module.enroll(3, 1001);
+  bench.component.setup();
+  bench.run_for_ms(1000);
+  if (auto_match)
+    bench.component.auto_match_mode();
+  bench.run_for_ms(2000);
+
+  // 自动验证的搜索在模组内完成, 以 PS_AutoIdentify 指令数计
+  auto searches = [&bench]() { return bench.module.command_count(0x04) + bench.module.command_count(0x32); };
+  uint64_t press_ms = SimClock::now_us() / 1000;
+  bench.module.add_touch(press_ms, press_ms + hold_ms, 1001);
+  uint32_t commands = bench.module.total_commands();
+  uint32_t search_commands = searches();
+  uint32_t matches = bench.match_id.publish_count;
+  bench.run_for_ms(hold_ms);
+  commands = bench.module.total_commands() - commands;
+  search_commands = searches() - search_commands;
+  matches = bench.match_id.publish_count - matches;
+
+  // 手指离开后再次按压应能马上解锁
+  uint32_t held_matches = bench.match_id.publish_count;
+  uint64_t again_ms = SimClock::now_us() / 1000 + 500;
+  bench.module.add_touch(again_ms, again_ms + 800, 1001);
+  bench.run_for_ms(2000);
+  bool again = bench.match_id.publish_count > held_matches;
+
+  const char *label = auto_match ? "held finger (auto match)" : config.touch_wake ? "held finger (touch)" : "held finger (poll)";
+  printf("  %-28s %u matches, %u searches, %.1f cmd/s while held, %s after lift\n", label, matches, search_commands,
+         commands / (hold_ms / 1000.0), again ? "unlocks again" : "no unlock");
+}
+
+// 稀疏指纹库: 大容量库中只有几个分散的模板, 按压最后一个模板对应的手指
+void bench_sparse_library(const BenchConfig &config) {
+  const int trials = 5;
+  Stats latency;
+  Stats pages;
+
+  for (int i = 0; i < trials; i++) {
+    Bench bench(config);
+    bench.module.set_capacity(1000);
+    bench.module.enroll(2, 1001);
+    bench.module.enroll(3, 1002);
+    bench.module.enroll(410, 1003);
+    bench.module.enroll(900, 1004);
+    bench.component.setup();
+    bench.run_for_ms(3000);
+
+    uint64_t press_ms = SimClock::now_us() / 1000 + 137 * i;
+    bench.module.add_touch(press_ms, press_ms + 2500, 1004);
+    bench.run_until_us(press_ms * 1000);
+
+    uint64_t deadline = SimClock::now_us() + 5000000;
+    while (!bench.match_sensor.state && SimClock::now_us() < deadline)
+      bench.run_until_us(SimClock::now_us() + SIM_TICK_US);
+    if (bench.match_sensor.state) {
+      latency.add((SimClock::now_us() - press_ms * 1000) / 1000.0);
+      pages.add(bench.search_pages.state);
+    }
+  }
+
+  latency.print(config.touch_wake ? "sparse unlock (touch)" : "sparse unlock (poll)", "ms");
+  pages.print("sparse search pages", "pages");
+}
+
+// 候选优先比对: 1000 页全满的指纹库, 4 个常用用户注册在靠后的页, 按压占比 40/20/10/10%, 其余为随机用户;
+// 比较关闭和开启候选比对时的解锁延迟、候选命中率和每次解锁发给模组的指令数
+void bench_candidate_match(const BenchConfig &config) {
+  // 每10次按压的顺序, 0 表示随机用户
+  const uint16_t pattern[] = {990, 910, 990, 0, 820, 990, 910, 700, 990, 0};
+  const int presses = 40;
+
+  for (uint8_t candidates : {0, 2, 4}) {
+    Bench bench(config);
+    bench.module.set_capacity(1000);
+    for (uint16_t page = 0; page < 1000; page++)
+      bench.module.enroll(page, 2000 + page);
+    bench.component.set_candidate_count(candidates);
+    bench.component.setup();
+    bench.run_for_ms(3000);
+
+    Stats latency;
+    int misses = 0;
+    uint32_t commands = bench.module.total_commands();
+    for (int i = 0; i < presses; i++) {
+      uint16_t page = pattern[i % 10] != 0 ? pattern[i % 10] : (i * 37) % 1000;
+      uint64_t press_ms = SimClock::now_us() / 1000 + 1500 + 137 * (i % 5);
+      bench.module.add_touch(press_ms, press_ms + 600, 2000 + page);
+      bench.run_until_us(press_ms * 1000);
+      uint32_t matches = bench.match_id.publish_count;
+
+      uint64_t deadline = SimClock::now_us() + 5000000;
+      while (bench.match_id.publish_count == matches && SimClock::now_us() < deadline)
+        bench.run_until_us(SimClock::now_us() + SIM_TICK_US);
+      if (bench.match_id.publish_count == matches || bench.match_id.state != page) {
+        misses++;
+        continue;
+      }
+      latency.add((SimClock::now_us() - press_ms * 1000) / 1000.0);
+    }
+    bench.run_for_ms(1000);
+
+    char label[40];
+    if (candidates == 0) {
+      snprintf(label, sizeof(label), "unlock (1:N search only)");
+    } else {
+      snprintf(label, sizeof(label), "unlock (%u candidates)", candidates);
+    }
+    latency.print(label, "ms");
+    uint32_t hits = bench.component.get_candidate_hits();
+    uint32_t tried = hits + bench.component.get_candidate_misses();
+    printf("  %-28s candidate hits %u/%u, %.1f cmd/unlock%s\n", "", hits, tried,
+           (bench.module.total_commands() - commands) / static_cast<double>(presses),
+           misses ? ", wrong or missed unlocks" : "");
+  }
+}
+
+// 按压一次并等待 match_id 上报; 返回解锁延迟 (毫秒), 没有上报或 ID 不对时返回负数
+template<typename Step> double press_and_wait(Reader &bench, Step step, uint16_t id, uint64_t delay_ms) {
+  uint64_t press_ms = SimClock::now_us() / 1000 + delay_ms;
+  bench.module.add_touch(press_ms, press_ms + 600, 2000 + id);
+  step(press_ms * 1000);
+  uint32_t matches = bench.match_id.publish_count;
+  uint64_t deadline = SimClock::now_us() + 5000000;
+  while (bench.match_id.publish_count == matches && SimClock::now_us() < deadline)
+    step(SimClock::now_us() + SIM_TICK_US);
+  if (bench.match_id.publish_count == matches || bench.match_id.state != id)
+    return -1;
+  return (SimClock::now_us() - press_ms * 1000) / 1000.0;
+}
+
+// 指纹库重排: 容量 1000, 前 600 页占满, 4 个常用用户注册在 500~590 页, 按压顺序同候选优先比对;
+// 按压 40 次后空闲 60 秒让组件重排, 再按压 40 次, 比较前后的解锁延迟, 并检查 match_id 仍是注册时的 ID
+void bench_library_optimizer(const BenchConfig &config) {
+  const uint16_t pattern[] = {590, 560, 590, 0, 530, 590, 560, 500, 590, 0};
+  const int presses = 40;
+
+  Bench bench(config);
+  bench.module.set_capacity(1000);
+  for (uint16_t page = 0; page < 600; page++)
+    bench.module.enroll(page, 2000 + page);
+  bench.component.set_optimize_library(true);
+  bench.component.setup();
+  bench.run_for_ms(3000);
+
+  auto step = [&bench](uint64_t end_us) { bench.run_until_us(end_us); };
+  Stats latency[2];
+  int wrong = 0;
+  for (int round = 0; round < 2; round++) {
+    for (int i = 0; i < presses; i++) {
+      uint16_t id = pattern[i % 10] != 0 ? pattern[i % 10] : (i * 37) % 600;
+      double ms = press_and_wait(bench, step, id, 1500 + 137 * (i % 5));
+      if (ms < 0) {
+        wrong++;
+      } else {
+        latency[round].add(ms);
+      }
+    }
+    if (round == 0)
+      bench.run_for_ms(60000);
+  }
+
+  latency[0].print("unlock before optimizing", "ms");
+  latency[1].print("unlock after optimizing", "ms");
+  printf("  %-28s %u templates moved, %u remapped IDs, %zu templates in library%s\n", "",
+         bench.component.get_template_moves(), bench.component.get_page_remap().size(), bench.module.library().size(),
+         wrong ? ", wrong or missed unlocks" : "");
+
+  // 映射非恒等时, 超出容量的删除请求应被拒绝, 不能在什么都没删的情况下报告成功
+  uint32_t deletes = bench.module.command_count(ZW101Component::CMD_DEL_CHAR);
+  bool refused = !bench.component.delete_range(1000, 1) && !bench.component.delete_range(990, 20) &&
+                 !bench.component.delete_range(5, 0);
+  bench.run_for_ms(500);
+  printf("  %-28s %s\n", "out-of-range delete",
+         refused && bench.module.command_count(ZW101Component::CMD_DEL_CHAR) == deletes ? "refused" : "ACCEPTED");
+}
+
+// 搬移中断电: 常用用户 (590 页) 要搬两次, 先把 0 页的模板挪到后面, 再把常用用户搬到 0 页;
+// 在每次搬移的读出、存储、删除指令到达模组时让组件掉电 (未落盘的偏好设置丢失), 重建组件后
+// 检查模板一个不少、没有多余副本, 搬移涉及的用户仍以原来的 ID 解锁
+void bench_relocation_crash(const BenchConfig &config) {
+  const uint8_t steps[] = {ZW101Component::CMD_LOAD_CHAR, ZW101Component::CMD_STORE_CHAR,
+                           ZW101Component::CMD_DEL_CHAR};
+  const char *const names[] = {"load", "store", "delete"};
+
+  for (int move = 1; move <= 2; move++) {
+    for (int s = 0; s < 3; s++) {
+      Bench bench(config);
+      bench.module.set_capacity(1000);
+      for (uint16_t page = 0; page < 600; page++)
+        bench.module.enroll(page, 2000 + page);
+
+      // 组件由本测试创建和销毁, 与 Bench 自带的组件一样接在同一个串口和传感器上
+      uint64_t next_loop_us = 0;
+      auto boot = [&bench, &next_loop_us]() {
+        auto component = std::unique_ptr<ZW101Component>(new ZW101Component());
+        component->set_uart_parent(&bench.uart);
+        component->set_fingerprint_sensor(&bench.match_sensor);
+        component->set_match_id_sensor(&bench.match_id);
+        component->set_optimize_library(true);
+        component->setup();
+        next_loop_us = SimClock::now_us();
+        return component;
+      };
+      std::unique_ptr<ZW101Component> component = boot();
+      auto step = [&](uint64_t end_us) {
+        while (SimClock::now_us() < end_us) {
+          if (SimClock::now_us() >= next_loop_us) {
+            component->loop();
+            next_loop_us = SimClock::now_us() + config.loop_interval_us;
+          }
+          bench.module.poll();
+          SimClock::advance_us(SIM_TICK_US);
+        }
+      };
+      step(SimClock::now_us() + 3000000);
+      for (int i = 0; i < 4; i++)
+        press_and_wait(bench, step, 590, 1500);
+
+      uint32_t target = bench.module.command_count(steps[s]) + move;
+      uint64_t deadline = SimClock::now_us() + 60000000;
+      while (bench.module.command_count(steps[s]) < target && SimClock::now_us() < deadline)
+        step(SimClock::now_us() + SIM_TICK_US);
+      bool crashed = bench.module.command_count(steps[s]) >= target;
+
+      // 掉电后重新启动需要一段时间, 期间模组照常处理已收到的指令
+      esphome::global_preferences->discard_unsynced();
+      component.reset();
+      uint64_t boot_us = SimClock::now_us() + 500000;
+      while (SimClock::now_us() < boot_us) {
+        bench.module.poll();
+        SimClock::advance_us(SIM_TICK_US);
+      }
+      uint8_t stale;  // 重启时串口接收缓冲被清空
+      while (bench.uart.available() > 0)
+        bench.uart.read_array(&stale, 1);
+      component = boot();
+      step(SimClock::now_us() + 5000000);
+      // 常用用户和被挪到后面的 0 页用户都以原来的 ID 解锁
+      bool id_ok = press_and_wait(bench, step, 590, 500) >= 0 && press_and_wait(bench, step, 0, 1500) >= 0;
+
+      std::vector<bool> seen(600, false);
+      size_t copies = 0;
+      for (const auto &entry : bench.module.library()) {
+        uint32_t finger = entry.second - 2000;
+        if (finger < 600 && seen[finger]) {
+          copies++;
+        } else if (finger < 600) {
+          seen[finger] = true;
+        }
+      }
+      size_t kept = std::count(seen.begin(), seen.end(), true);
+
+      char label[40];
+      snprintf(label, sizeof(label), "crash at %s (move %d)", names[s], move);
+      printf("  %-28s %zu/600 templates, %zu extra copies, match_id %s%s\n", label, kept, copies,
+             id_ok ? "unchanged" : "WRONG", crashed ? "" : " (move not reached)");
+    }
+  }
+}
+
+// 双读头重排: 两个读头接在不同串口, 都用出厂地址, 常用用户分别在 590 和 560 页;
+// 各自重排后用同样的组件 ID 重建组件, 读回的 ID 映射应与重启前各自的映射一致
+void bench_two_reader_remap(const BenchConfig &config) {
+  const char *const ids[] = {"door_in", "door_out"};
+  const uint16_t frequent[] = {590, 560};
+
+  Bench bench(config, 1);
+  for (size_t i = 0; i < 2; i++) {
+    Reader &reader = bench.reader(i);
+    reader.module.set_capacity(1000);
+    for (uint16_t page = 0; page < 600; page++)
+      reader.module.enroll(page, 2000 + page);
+    reader.component.set_optimize_library(true);
+    reader.component.set_preference_key(ids[i]);
+  }
+  bench.setup();
+  bench.run_for_ms(3000);
+
+  auto step = [&bench](uint64_t end_us) { bench.run_until_us(end_us); };
+  for (size_t i = 0; i < 2; i++) {
+    for (int n = 0; n < 4; n++)
+      press_and_wait(bench.reader(i), step, frequent[i], 1500);
+  }
+  bench.run_for_ms(60000);
+
+  for (size_t i = 0; i < 2; i++) {
+    const ZW101Component &live = bench.reader(i).component;
+    VirtualUART uart;  // 只读回偏好设置, 不与模组通信
+    ZW101Component restored;
+    restored.set_uart_parent(&uart);
+    restored.set_preference_key(ids[i]);
+    restored.setup();
+    int mismatched = 0;
+    for (uint16_t id = 0; id < 600; id++) {
+      if (restored.get_page_remap().page_of(id) != live.get_page_remap().page_of(id))
+        mismatched++;
+    }
+    char label[40];
+    snprintf(label, sizeof(label), "two readers, %s", ids[i]);
+    printf("  %-28s %u remapped IDs, %s after restart\n", label, live.get_page_remap().size(),
+           mismatched ? "WRONG mapping" : "mapping restored");
+  }
+}
+
+// 指令延迟: 连续按压若干次, 输出组件统计的各指令往返延迟
+void bench_command_latency(const BenchConfig &config) {
+  Bench bench(config);
+  bench.module.enroll(3, 1001);
+  bench.component.setup();
+  bench.run_for_ms(3000);
+  for (int i = 0; i < 5; i++) {
+    uint64_t press_ms = SimClock::now_us() / 1000 + 500;
+    bench.module.add_touch(press_ms, press_ms + 800, 1001);
+    bench.run_for_ms(4500);
+  }
+
+  const auto &stats = bench.component.get_command_stats();
+  for (uint8_t i = 0; i < stats.size(); i++) {
+    const auto &latency = stats.at(i);
+    char label[32];
+    snprintf(label, sizeof(label), "cmd 0x%02X round trip", latency.cmd);
+    printf("  %-28s n=%-3u min=%7.1f avg=%7.1f p95=%7.1f max=%7.1f ms (queue %.1f ms)\n", label,
+           (unsigned) latency.count, latency.min_us / 1000.0, latency.avg_us() / 1000.0,
+           latency.percentile_us(95) / 1000.0, latency.max_us / 1000.0, latency.avg_wait_us() / 1000.0);
+  }
+}
+
+// 模板备份/恢复: 上传第3页的模板, 再下载存入第10页, 校验数据和指纹库;
+// 再次上传时破坏第二个数据包中的一个字节, 上传应失败, 随后的上传不受影响
+void bench_template_transfer(const BenchConfig &config) {
+  Bench bench(config);
+  bench.module.enroll(3, 7);
+  bench.component.setup();
+  bench.run_for_ms(1000);
+
+  std::vector<uint8_t> backup;
+  int result = -1;
+  uint64_t start = SimClock::now_us();
+  bench.component.upload_template(
+      3, [&](const uint8_t *data, uint16_t length, bool last) { backup.insert(backup.end(), data, data + length); },
+      [&](bool ok) { result = ok; });
+  while (result < 0 && SimClock::now_us() - start < 10000000)
+    bench.run_for_ms(1);
+  bool intact = result == 1 && backup == ModuleSimulator::make_template(7);
+  printf("  %-28s %.1f ms (%zu bytes, %s)\n", "template upload", (SimClock::now_us() - start) / 1000.0,
+         backup.size(), intact ? "intact" : "corrupt");
+
+  size_t offset = 0;
+  result = -1;
+  start = SimClock::now_us();
+  bench.component.download_template(
+      10, backup.size(),
+      [&](uint8_t *buffer, uint16_t length) {
+        uint16_t n = std::min<size_t>(length, backup.size() - offset);
+        memcpy(buffer, backup.data() + offset, n);
+        offset += n;
+        return n;
+      },
+      [&](bool ok) { result = ok; });
+  while (result < 0 && SimClock::now_us() - start < 10000000)
+    bench.run_for_ms(1);
+  auto it = bench.module.library().find(10);
+  bool stored = result == 1 && it != bench.module.library().end() && it->second == 7;
+  printf("  %-28s %.1f ms (%s)\n", "template download + store", (SimClock::now_us() - start) / 1000.0,
+         stored ? "stored" : "failed");
+
+  // 模组依次发出 PS_LoadChar 应答、PS_UpChar 应答 (各12字节) 和数据包 (9 + 数据 + 2 字节)
+  const uint64_t ack_size = 12;
+  const uint64_t packet_size = 9 + 128 + 2;
+  for (bool corrupt : {true, false}) {
+    std::vector<uint8_t> received;
+    result = -1;
+    if (corrupt)
+      bench.uart.corrupt_to_host(bench.uart.bytes_to_host() + 2 * ack_size + packet_size + 20);
+    start = SimClock::now_us();
+    bench.component.upload_template(
+        3,
+        [&](const uint8_t *data, uint16_t length, bool last) {
+          received.insert(received.end(), data, data + length);
+        },
+        [&](bool ok) { result = ok; });
+    while (result < 0 && SimClock::now_us() - start < 10000000)
+      bench.run_for_ms(1);
+    const char *outcome = result < 0 ? "no result" : result == 1 ? "reported ok" : "reported failed";
+    printf("  %-28s %.1f ms (%s, %zu bytes to sink%s)\n",
+           corrupt ? "upload, 1 byte corrupted" : "upload after corruption", (SimClock::now_us() - start) / 1000.0, outcome, received.size(),
+           !corrupt && result == 1 && received == ModuleSimulator::make_template(7) ? ", intact" : "");
+  }
+}
+
+// 批量操作: 200 页容量中 60 个模板, 删除其中 40 个 (逐个删除 vs 合并区间删除);
+// 再按期望集合核对指纹库, 缺失的页批量下载
+void bench_bulk_operations(const BenchConfig &config) {
+  std::vector<uint16_t> departed;
+  for (uint16_t page = 20; page < 100; page += 2)
+    departed.push_back(page);
+
+  for (bool batched : {false, true}) {
+    Bench bench(config);
+    bench.module.set_capacity(200);
+    for (uint16_t page = 0; page < 120; page += 2)
+      bench.module.enroll(page, 1000 + page);
+    bench.component.setup();
+    bench.run_for_ms(1000);
+
+    uint32_t before = bench.module.total_commands();
+    uint64_t start = SimClock::now_us();
+    size_t done = 0;
+    bool ok = true;
+    // 队列只有8个槽位, 逐个删除时上一条完成后再入队
+    std::function<void(bool)> next = [&](bool result) {
+      ok = ok && result;
+      if (++done < departed.size())
+        bench.component.delete_fingerprint(departed[done], next);
+    };
+    if (batched) {
+      bench.component.delete_fingerprints(departed, [&](bool result) {
+        ok = result;
+        done = departed.size();
+      });
+    } else {
+      bench.component.delete_fingerprint(departed[0], next);
+    }
+    while (done < departed.size() && SimClock::now_us() - start < 60000000)
+      bench.run_for_ms(1);
+    printf("  %-28s %.1f ms, %u commands, %zu left in library%s\n",
+           batched ? "batch delete 40 IDs" : "delete 40 IDs one by one", (SimClock::now_us() - start) / 1000.0,
+           bench.module.total_commands() - before, bench.module.library().size(), ok ? "" : " (failed)");
+  }
+
+  // 核对: 模组中 0..118 的偶数页, 期望为 0..39 全部页 (多 40 个偶数页之外的需删除, 奇数页缺失需下载)
+  Bench bench(config);
+  bench.module.set_capacity(200);
+  for (uint16_t page = 0; page < 120; page += 2)
+    bench.module.enroll(page, 1000 + page);
+  bench.component.setup();
+  bench.run_for_ms(1000);
+
+  std::vector<uint16_t> desired;
+  for (uint16_t page = 0; page < 40; page++)
+    desired.push_back(page);
+  std::vector<uint16_t> missing;
+  int result = -1;
+  uint32_t before = bench.module.total_commands();
+  uint64_t start = SimClock::now_us();
+  bench.component.reconcile_library(desired, [&](bool ok, const std::vector<uint16_t> &pages) {
+    missing = pages;
+    result = ok;
+  });
+  while (result < 0 && SimClock::now_us() - start < 60000000)
+    bench.run_for_ms(1);
+  printf("  %-28s %.1f ms, %u commands, %zu missing\n", "reconcile library", (SimClock::now_us() - start) / 1000.0,
+         bench.module.total_commands() - before, missing.size());
+
+  result = -1;
+  before = bench.module.total_commands();
+  start = SimClock::now_us();
+  bench.component.download_templates(
+      missing, ModuleSimulator::TEMPLATE_SIZE,
+      [](uint16_t page) -> ZW101Component::DataSource {
+        auto data = std::make_shared<std::vector<uint8_t>>(ModuleSimulator::make_template(1000 + page));
+        auto offset = std::make_shared<size_t>(0);
+        return [data, offset](uint8_t *buffer, uint16_t length) {
+          uint16_t n = std::min<size_t>(length, data->size() - *offset);
+          memcpy(buffer, data->data() + *offset, n);
+          *offset += n;
+          return n;
+        };
+      },
+      [&](bool ok, const std::vector<uint16_t> &) { result = ok; });
+  while (result < 0 && SimClock::now_us() - start < 60000000)
+    bench.run_for_ms(1);
+  bool matches = bench.module.library().size() == desired.size();
+  for (uint16_t page : desired) {
+    auto it = bench.module.library().find(page);
+    matches = matches && it != bench.module.library().end() && it->second == 1000u + page;
+  }
+  printf("  %-28s %.1f ms, %u commands (%s)\n", "batch download missing", (SimClock::now_us() - start) / 1000.0,
+         bench.module.total_commands() - before, matches ? "library matches" : "library differs");
+}
+
+// 波特率升级: 两端从 57600 启动, 目标 115200; 随后模组断电重启且未保存波特率
+void bench_baud_upgrade() {
+  BenchConfig config;
+  Bench bench(config);
+  bench.module.set_baud_persistent(false);
+  bench.component.set_target_baud_rate(115200);
+  bench.component.setup();
+
+  uint64_t start = SimClock::now_us();
+  while (bench.uart.get_module_baud_rate() != 115200 || bench.uart.get_baud_rate() != 115200 ||
+         !bench.component.get_template_index().is_loaded()) {
+    if (SimClock::now_us() - start > 10000000)
+      break;
+    bench.run_until_us(SimClock::now_us() + SIM_TICK_US);
+  }
+  printf("  %-28s %.1f ms (module %u, host %u baud)\n", "upgrade to 115200", (SimClock::now_us() - start) / 1000.0,
+         bench.uart.get_module_baud_rate(), bench.uart.get_baud_rate());
+
+  // 模组断电重启回到 57600, 组件在连续超时后重新探测并再次升级
+  bench.run_for_ms(5000);
+  bench.module.power_cycle();
+  start = SimClock::now_us();
+  uint32_t recovered_at = 0;
+  bench.run_for_ms(100);
+  while (SimClock::now_us() - start < 60000000) {
+    bench.run_for_ms(100);
+    if (bench.uart.get_module_baud_rate() == 115200 && bench.uart.get_baud_rate() == 115200 &&
+        bench.component.pending_command_count() == 0) {
+      recovered_at = (SimClock::now_us() - start) / 1000;
+      break;
+    }
+  }
+  if (recovered_at) {
+    printf("  %-28s %u ms\n", "recover after power cycle", recovered_at);
+  } else {
+    printf("  %-28s not recovered (module %u, host %u baud)\n", "recover after power cycle",
+           bench.uart.get_module_baud_rate(), bench.uart.get_baud_rate());
+  }
+}
+
+// 灯控合并: 一次循环内连发多个状态、每100ms重复设置同一状态、搜索进行中改灯, 统计实际发出的灯控帧;
+// 再改灯后立即进入自动验证, 灯控不应被自动模式挡住
+void bench_led_commands(const BenchConfig &config) {
+  Bench bench(config);
+  bench.module.enroll(3, 1001);
+  bench.component.setup();
+  bench.run_for_ms(1000);
+  uint32_t requests = 0;
+  uint32_t frames = bench.module.command_count(0x3C);
+
+  // 动画式连发: 只有最后一个状态需要发出
+  for (uint8_t color = 1; color <= 7; color++, requests++)
+    bench.component.set_rgb_led(1, color, 100);
+  bench.run_for_ms(200);
+  // 自动化中反复设置同一状态
+  for (int i = 0; i < 20; i++, requests++) {
+    bench.component.set_rgb_led(3, 4, 150);
+    bench.run_for_ms(100);
+  }
+
+  // 搜索进行中改灯: 灯控帧排在搜索之后, 应答不会被当作搜索结果
+  uint64_t press_ms = SimClock::now_us() / 1000 + 100;
+  bench.module.add_touch(press_ms, press_ms + 800, 1001);
+  bench.run_until_us(press_ms * 1000 + 150000);
+  for (int i = 0; i < 3; i++, requests++)
+    bench.component.set_rgb_led(3, 2, 200);
+  bench.run_for_ms(2000);
+
+  printf("  %-28s %u requests, %u frames sent, %u skipped, %s\n", "led commands", requests,
+         bench.module.command_count(0x3C) - frames, bench.component.get_led_commands_skipped(),
+         bench.match_id.publish_count == 1 && bench.match_id.state == 3 ? "unlock ok" : "unlock failed");
+
+  // 改灯后立即进入自动验证 (配置示例中的按钮): 灯控帧应在自动指令之前发出, 自动验证照常解锁
+  frames = bench.module.command_count(0x3C);
+  uint32_t auto_commands = bench.module.command_count(0x32);
+  bench.component.set_rgb_led(3, 4, 150);
+  bool armed = bench.component.auto_match_mode();
+  bench.run_for_ms(500);
+  uint32_t led_frames = bench.module.command_count(0x3C) - frames;
+  press_ms = SimClock::now_us() / 1000 + 100;
+  bench.module.add_touch(press_ms, press_ms + 800, 1001);
+  bench.run_for_ms(4500);
+  bench.component.cancel_auto_mode();
+  printf("  %-28s %u frames sent, auto match %s, %s\n", "led then auto match", led_frames,
+         armed && bench.module.command_count(0x32) > auto_commands ? "armed" : "not armed",
+         bench.match_id.publish_count == 2 && bench.match_id.state == 3 ? "unlock ok" : "unlock failed");
+}
+
+// 空闲流量: 无手指按压时模组收到的指令数、其中的采图次数 (传感器上电采集) 和模组忙碌时间占比;
+// 轮询模式下另测模组不支持检查手指指令 (0x9D) 时退回采图探测的情况
+void bench_idle_traffic(const BenchConfig &config) {
+  for (bool check_finger : {true, false}) {
+    if (config.touch_wake && !check_finger)
+      break;
+    Bench bench(config);
+    bench.module.set_check_finger_supported(check_finger);
+    bench.component.setup();
+    bench.run_for_ms(2000);
+
+    uint32_t before = bench.module.total_commands();
+    uint32_t captures = bench.module.command_count(0x01);
+    uint64_t busy = bench.module.busy_us();
+    bench.run_for_ms(10000);
+    const char *label = config.touch_wake ? "idle traffic (touch)"
+                        : check_finger    ? "idle traffic (poll)"
+                                          : "idle traffic (no 0x9D)";
+    printf("  %-28s %.1f cmd/s, %.1f captures/s, module busy %.1f%%\n", label,
+           (bench.module.total_commands() - before) / 10.0, (bench.module.command_count(0x01) - captures) / 10.0,
+           (bench.module.busy_us() - busy) / 100000.0);
+  }
+}
+
+// 休眠唤醒: 空闲 sleep_timeout 后自动休眠 (第一次休眠指令失败, 由重试完成), 每7秒按压一次;
+// 休眠中按下时模组先上电、握手确认后才采图, 统计唤醒耗时和解锁延迟, 以及模组处于休眠的时间占比
+void bench_sleep_wake(BenchConfig config) {
+  config.touch_wake = true;  // 休眠后只能由触摸唤醒
+  for (uint32_t timeout_ms : {0u, 2000u, 10000u}) {
+    Bench bench(config);
+    bench.module.enroll(3, 1001);
+    bench.module.set_sleep_failures(1);
+    bench.component.set_sleep_timeout(timeout_ms);
+    bench.component.setup();
+    bench.run_for_ms(1000);
+
+    const int presses = 8;
+    Stats latency;
+    Stats wake;
+    int misses = 0;
+    uint64_t start_us = SimClock::now_us();
+    uint64_t asleep_before = bench.module.asleep_us();
+    for (int i = 0; i < presses; i++) {
+      uint64_t press_ms = SimClock::now_us() / 1000 + 7000 + 137 * i;
+      bench.module.add_touch(press_ms, press_ms + 1500, 1001);
+      bench.run_until_us(press_ms * 1000);
+      bool asleep = bench.component.is_asleep();
+      uint32_t matches = bench.match_id.publish_count;
+
+      uint64_t deadline = SimClock::now_us() + 5000000;
+      while (bench.match_id.publish_count == matches && SimClock::now_us() < deadline)
+        bench.run_until_us(SimClock::now_us() + SIM_TICK_US);
+      if (bench.match_id.publish_count == matches) {
+        misses++;
+        continue;
+      }
+      latency.add((SimClock::now_us() - press_ms * 1000) / 1000.0);
+      if (asleep)
+        wake.add(bench.component.get_last_wake_latency());
+    }
+    bench.run_for_ms(3000);
+
+    char label[40];
+    if (timeout_ms == 0) {
+      snprintf(label, sizeof(label), "unlock (never sleep)");
+    } else {
+      snprintf(label, sizeof(label), "unlock (sleep after %u s)", timeout_ms / 1000);
+    }
+    latency.print(label, "ms");
+    printf("  %-28s woke %zu/%d times, avg %.1f ms; module asleep %.0f%% of the time%s\n", "", wake.samples.size(),
+           presses, wake.mean(),
+           (bench.module.asleep_us() - asleep_before) * 100.0 / (SimClock::now_us() - start_us),
+           misses ? ", missed unlocks" : "");
+  }
+}
+
+void usage(const char *prog) {
+  fprintf(stderr, "usage: %s [-l loop_interval_ms] [-b baud_rate] [-v]\n", prog);
+  exit(1);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  BenchConfig config;
+  std::vector<uint32_t> baud_rates;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+      config.loop_interval_us = static_cast<uint32_t>(atof(argv[++i]) * 1000);
+    } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+      baud_rates.push_back(static_cast<uint32_t>(atoi(argv[++i])));
+    } else if (strcmp(argv[i], "-v") == 0) {
+      esphome::sim_log_level = esphome::SIM_LOG_DEBUG;
+    } else {
+      usage(argv[0]);
+    }
+  }
+  if (baud_rates.empty())
+    baud_rates = {57600, 115200};
+
+  for (uint32_t baud : baud_rates) {
+    config.baud_rate = baud;
+    printf("baud %u, loop interval %.1f ms\n", baud, config.loop_interval_us / 1000.0);
+    for (bool touch_wake : {false, true}) {
+      config.touch_wake = touch_wake;
+      bench_unlock_latency(config);
+      bench_dual_reader_latency(config);
+      bench_shared_bus_latency(config);
+      bench_repeat_unlock_latency(config);
+      bench_held_finger(config, false);
+      bench_idle_traffic(config);
+    }
+    bench_sparse_library(config);
+    bench_candidate_match(config);
+    bench_library_optimizer(config);
+    bench_relocation_crash(config);
+    bench_two_reader_remap(config);
+    bench_auto_match_latency(config);
+    bench_held_finger(config, true);
+    bench_enrollment(config);
+    bench_auto_enroll_duplicate(config);
+    bench_sleep_wake(config);
+    config.touch_wake = false;
+    bench_command_latency(config);
+    bench_command_throughput(config);
+    bench_template_transfer(config);
+    bench_set_address(config);
+    bench_led_commands(config);
+    bench_bulk_operations(config);
+  }
+  printf("baud negotiation\n");
+  bench_baud_upgrade();
+  return 0;
+}
@@ -0,0 +1,141 @@
+#include "capture.h"
+#include "zw101_protocol.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+namespace zw101_sim {
+
+using esphome::zw101::FrameTrace;
+
+static const char *const DIRECTIONS[] = {"TX", "RX", "TO", "CK"};
+
+static const uint8_t CMD_GET_IMAGE = 0x01;
+static const uint8_t CMD_SEARCH = 0x04;
+static const uint8_t AUTO_STAGE_GET_IMAGE = 0x01;
+static const uint8_t AUTO_STAGE_SEARCH = 0x05;
+static const uint16_t AUTO_MATCH_REPLY_SIZE = 17;
+
+void Capture::add(uint32_t time_us, FrameTrace::Direction direction, uint16_t length, const uint8_t *data,
+                  size_t size) {
+  if (!frames_.empty() && time_us < last_raw_us_)
+    wrap_us_ += 1ULL << 32;
+  last_raw_us_ = time_us;
+  frames_.push_back({wrap_us_ + time_us, direction, length, std::vector<uint8_t>(data, data + size)});
+}
+
+bool Capture::load(const std::string &path) {
+  std::ifstream in(path);
+  if (!in)
+    return false;
+
+  frames_.clear();
+  wrap_us_ = 0;
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.compare(0, 1, "#") == 0) {
+      size_t pos = line.find("baud=");
+      if (pos != std::string::npos)
+        baud_rate_ = static_cast<uint32_t>(atoi(line.c_str() + pos + 5));
+      continue;
+    }
+
+    size_t pos = line.find("trace ");
+    if (pos == std::string::npos)
+      continue;
+    char dir[4];
+    unsigned time_us, length;
+    char hex[FrameTrace::MAX_RECORD_BYTES * 2 + 2] = "";
+    int fields = sscanf(line.c_str() + pos, "trace %u %3s %u %96s", &time_us, dir, &length, hex);
+    if (fields < 3)
+      continue;
+
+    int direction = -1;
+    for (int i = 0; i < 4; i++) {
+      if (strcmp(dir, DIRECTIONS[i]) == 0)
+        direction = i;
+    }
+    if (direction < 0)
+      continue;
+
+    uint8_t data[FrameTrace::MAX_RECORD_BYTES];
+    size_t size = 0;
+    for (size_t i = 0; hex[i] != '\0' && hex[i + 1] != '\0' && size < sizeof(data); i += 2) {
+      char byte[3] = {hex[i], hex[i + 1], '\0'};
+      data[size++] = static_cast<uint8_t>(strtoul(byte, nullptr, 16));
+    }
+    add(time_us, static_cast<FrameTrace::Direction>(direction), length, data, size);
+  }
+  return true;
+}
+
+bool Capture::save(const std::string &path) const {
+  FILE *out = fopen(path.c_str(), "w");
+  if (out == nullptr)
+    return false;
+
+  fprintf(out, "# zw101 capture, baud=%u\n", baud_rate_);
+  for (const auto &frame : frames_) {
+    fprintf(out, "trace %10u %s %3u ", static_cast<uint32_t>(frame.time_us), DIRECTIONS[frame.direction & 3],
+            frame.length);
+    for (uint8_t byte : frame.data)
+      fprintf(out, "%02X", byte);
+    fputc('\n', out);
+  }
+  fclose(out);
+  return true;
+}
+
+void Capture::add_trace(const FrameTrace &trace) {
+  trace.for_each([this](const FrameTrace::Record &record, const uint8_t *data) {
+    add(record.time_us, record.direction, record.length, data, record.stored);
+  });
+}
+
+std::vector<Unlock> find_unlocks(const Capture &capture) {
+  std::vector<Unlock> unlocks;
+  const auto &frames = capture.frames();
+  uint64_t capture_start = 0;  // 最近一次返回 OK 的采图指令发出时间, 0 表示没有
+  uint64_t pending_tx = 0;
+  uint8_t pending_cmd = 0;
+
+  for (const auto &frame : frames) {
+    if (frame.data.size() <= esphome::zw101::CMD_CODE_START_POS)
+      continue;
+    uint8_t pid = frame.data[6];
+    uint8_t code = frame.data[esphome::zw101::CMD_CODE_START_POS];
+
+    if (frame.direction == FrameTrace::TRACE_TX && pid == esphome::zw101::PKG_CMD) {
+      pending_tx = frame.time_us;
+      pending_cmd = code;
+      continue;
+    }
+    if (frame.direction != FrameTrace::TRACE_RX || pid != esphome::zw101::PKG_ACK)
+      continue;
+
+    // 自动验证由模组采图, 以采图阶段应答为起点
+    bool auto_stage = frame.length == AUTO_MATCH_REPLY_SIZE && frame.data.size() > 10;
+    if (pending_cmd == CMD_GET_IMAGE && code == 0x00) {
+      capture_start = pending_tx;
+    } else if (auto_stage && frame.data[10] == AUTO_STAGE_GET_IMAGE && code == 0x00) {
+      capture_start = frame.time_us;
+    } else if (capture_start != 0 && code == 0x00 &&
+               (pending_cmd == CMD_SEARCH || (auto_stage && frame.data[10] == AUTO_STAGE_SEARCH))) {
+      unlocks.push_back({capture_start, (frame.time_us - capture_start) / 1000.0});
+      capture_start = 0;
+    }
+    pending_cmd = 0;
+  }
+  return unlocks;
+}
+
+std::vector<double> unlock_latencies_ms(const Capture &capture) {
+  std::vector<double> latencies;
+  for (const auto &unlock : find_unlocks(capture))
+    latencies.push_back(unlock.latency_ms);
+  return latencies;
+}
+
+}  // namespace zw101_sim
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "zw101_trace.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace zw101_sim {
+
+// 串口会话录像: 带时间戳的收发帧序列
+//
+// 文件格式与组件 dump_trace() 的日志行一致, 每行一帧:
+//   trace <时间(微秒)> <TX|RX|TO|CK> <原始帧长> <十六进制数据>
+// 行首的日志前缀会被忽略, 因此现场设备的日志可以直接作为录像使用;
+// 以 '#' 开头的行为注释, 其中 "# baud=<波特率>" 记录录制时的波特率。
+// 时间戳为设备 micros(), 32 位回绕在加载时展开为单调递增的 64 位时间。
+struct CaptureFrame {
+  uint64_t time_us;
+  esphome::zw101::FrameTrace::Direction direction;
+  uint16_t length;            // 原始帧长
+  std::vector<uint8_t> data;  // 保存的字节, 可能被截断
+
+  bool complete() const { return data.size() == length; }
+};
+
+class Capture {
+ public:
+  bool load(const std::string &path);
+  bool save(const std::string &path) const;
+
+  // 录制: 从组件的收发跟踪复制全部记录
+  void add_trace(const esphome::zw101::FrameTrace &trace);
+
+  const std::vector<CaptureFrame> &frames() const { return frames_; }
+  uint32_t baud_rate() const { return baud_rate_; }
+  void set_baud_rate(uint32_t baud_rate) { baud_rate_ = baud_rate; }
+  uint64_t duration_us() const { return frames_.empty() ? 0 : frames_.back().time_us - frames_.front().time_us; }
+
+ protected:
+  void add(uint32_t time_us, esphome::zw101::FrameTrace::Direction direction, uint16_t length, const uint8_t *data,
+           size_t size);
+
+  std::vector<CaptureFrame> frames_;
+  uint32_t baud_rate_{57600};
+  uint32_t last_raw_us_{0};
+  uint64_t wrap_us_{0};
+};
+
+// 录像中的一次解锁: 返回 OK 的采图指令发出 (自动验证为采图阶段应答) 的时间, 到搜索或自动验证返回匹配成功为止
+struct Unlock {
+  uint64_t start_us;  // 与 CaptureFrame::time_us 同一时间轴
+  double latency_ms;
+};
+std::vector<Unlock> find_unlocks(const Capture &capture);
+
+// 从录像中提取解锁延迟 (毫秒)
+std::vector<double> unlock_latencies_ms(const Capture &capture);
+
+}  // namespace zw101_sim
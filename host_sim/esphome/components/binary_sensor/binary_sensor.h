@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+
+// 主机仿真用的 binary_sensor::BinarySensor 替身
+namespace esphome {
+namespace binary_sensor {
+
+class BinarySensor {
+ public:
+  void publish_state(bool state) {
+    if (state && !this->state)
+      this->press_count++;
+    this->state = state;
+  }
+  bool state{false};
+  uint32_t press_count{0};
+};
+
+}  // namespace binary_sensor
+}  // namespace esphome
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+
+// 主机仿真用的 text_sensor::TextSensor 替身
+namespace esphome {
+namespace text_sensor {
+
+class TextSensor {
+ public:
+  void publish_state(const std::string &state) { this->state = state; }
+  std::string state;
+};
+
+}  // namespace text_sensor
+}  // namespace esphome
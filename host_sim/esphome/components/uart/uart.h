@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// 主机仿真用的 uart::UARTComponent / UARTDevice 替身
+// UARTComponent 由 VirtualUART 实现, UARTDevice 接口与 ESPHome 保持一致
+namespace esphome {
+namespace uart {
+
+class UARTComponent {
+ public:
+  virtual ~UARTComponent() = default;
+  virtual void write_array(const uint8_t *data, size_t len) = 0;
+  virtual bool peek_byte(uint8_t *data) = 0;
+  virtual bool read_array(uint8_t *data, size_t len) = 0;
+  virtual int available() = 0;
+  virtual void flush() = 0;
+  virtual void load_settings(bool dump_config = true) {}
+
+  void set_baud_rate(uint32_t baud_rate) { baud_rate_ = baud_rate; }
+  uint32_t get_baud_rate() const { return baud_rate_; }
+
+ protected:
+  uint32_t baud_rate_{57600};
+};
+
+class UARTDevice {
+ public:
+  UARTDevice() = default;
+  UARTDevice(UARTComponent *parent) : parent_(parent) {}
+
+  void set_uart_parent(UARTComponent *parent) { parent_ = parent; }
+
+  void write_byte(uint8_t data) { parent_->write_array(&data, 1); }
+  void write_array(const uint8_t *data, size_t len) { parent_->write_array(data, len); }
+  bool read_byte(uint8_t *data) { return parent_->read_array(data, 1); }
+  bool read_array(uint8_t *data, size_t len) { return parent_->read_array(data, len); }
+  bool peek_byte(uint8_t *data) { return parent_->peek_byte(data); }
+  int read() {
+    uint8_t data;
+    if (!read_byte(&data))
+      return -1;
+    return data;
+  }
+  int available() { return parent_->available(); }
+  void flush() { parent_->flush(); }
+
+ protected:
+  UARTComponent *parent_{nullptr};
+};
+
+}  // namespace uart
+}  // namespace esphome
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+
+#include "esphome/core/gpio.h"
+
+#define IRAM_ATTR
+
+// 主机仿真用的 ESPHome HAL 替身: 时间由仿真时钟驱动
+namespace esphome {
+
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+
+}  // namespace esphome
+
+void yield();
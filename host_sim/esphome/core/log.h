@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+
+// 主机仿真用的日志替身: 按 sim_log_level 过滤, 输出到 stderr
+namespace esphome {
+
+enum SimLogLevel { SIM_LOG_NONE = 0, SIM_LOG_ERROR, SIM_LOG_WARN, SIM_LOG_INFO, SIM_LOG_DEBUG };
+extern int sim_log_level;
+void sim_log(int level, const char *tag, const char *format, ...) __attribute__((format(printf, 3, 4)));
+void sim_log_hex(const char *tag, const uint8_t *data, int length);
+
+}  // namespace esphome
+
+#define ESP_LOGE(tag, ...) ::esphome::sim_log(::esphome::SIM_LOG_ERROR, tag, __VA_ARGS__)
+#define ESP_LOGW(tag, ...) ::esphome::sim_log(::esphome::SIM_LOG_WARN, tag, __VA_ARGS__)
+#define ESP_LOGI(tag, ...) ::esphome::sim_log(::esphome::SIM_LOG_INFO, tag, __VA_ARGS__)
+#define ESP_LOGD(tag, ...) ::esphome::sim_log(::esphome::SIM_LOG_DEBUG, tag, __VA_ARGS__)
+#define ESP_LOGV(tag, ...) ::esphome::sim_log(::esphome::SIM_LOG_DEBUG, tag, __VA_ARGS__)
+#define ESP_LOGCONFIG(tag, ...) ::esphome::sim_log(::esphome::SIM_LOG_INFO, tag, __VA_ARGS__)
+#define ESP_LOG_BUFFER_HEX(tag, buffer, length) \
+  ::esphome::sim_log_hex(tag, reinterpret_cast<const uint8_t *>(buffer), (int) (length))
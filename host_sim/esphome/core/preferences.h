@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <vector>
+
+// 主机仿真用的 ESPHome 偏好设置替身: 保存在内存中, 组件重建后仍然可以读回;
+// 与 ESP32 一样 save() 只写入待写缓冲, sync() 后才算写入 flash, discard_unsynced() 模拟写入前断电
+namespace esphome {
+
+class ESPPreferences;
+
+class ESPPreferenceObject {
+ public:
+  ESPPreferenceObject() = default;
+  ESPPreferenceObject(ESPPreferences *prefs, uint32_t type) : prefs_(prefs), type_(type) {}
+
+  template<typename T> bool save(const T *src);
+  template<typename T> bool load(T *dest);
+
+ protected:
+  ESPPreferences *prefs_{nullptr};
+  uint32_t type_{0};
+};
+
+class ESPPreferences {
+ public:
+  template<typename T> ESPPreferenceObject make_preference(uint32_t type, bool in_flash = false) {
+    return ESPPreferenceObject(this, type);
+  }
+  bool sync() {
+    for (auto &entry : pending_)
+      flash_[entry.first] = entry.second;
+    pending_.clear();
+    return true;
+  }
+
+  // 仿真用
+  void discard_unsynced() { pending_.clear(); }
+  void reset() {
+    pending_.clear();
+    flash_.clear();
+  }
+
+  // 读取时待写缓冲优先
+  bool read(uint32_t type, uint8_t *data, size_t length) const {
+    auto it = pending_.find(type);
+    if (it == pending_.end()) {
+      it = flash_.find(type);
+      if (it == flash_.end())
+        return false;
+    }
+    if (it->second.size() != length)
+      return false;
+    memcpy(data, it->second.data(), length);
+    return true;
+  }
+  void write(uint32_t type, const uint8_t *data, size_t length) { pending_[type].assign(data, data + length); }
+
+ protected:
+  std::map<uint32_t, std::vector<uint8_t>> pending_;
+  std::map<uint32_t, std::vector<uint8_t>> flash_;
+};
+
+template<typename T> bool ESPPreferenceObject::save(const T *src) {
+  if (prefs_ == nullptr)
+    return false;
+  prefs_->write(type_, reinterpret_cast<const uint8_t *>(src), sizeof(T));
+  return true;
+}
+
+template<typename T> bool ESPPreferenceObject::load(T *dest) {
+  return prefs_ != nullptr && prefs_->read(type_, reinterpret_cast<uint8_t *>(dest), sizeof(T));
+}
+
+extern ESPPreferences *global_preferences;
+
+}  // namespace esphome
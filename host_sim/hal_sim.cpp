@@ -0,0 +1,52 @@
+#include "sim_clock.h"
+#include "esphome/core/hal.h"
+#include "esphome/core/log.h"
+#include "esphome/core/preferences.h"
+
+#include <cstdarg>
+#include <cstdio>
+
+namespace zw101_sim {
+
+uint64_t SimClock::now_us_ = 0;
+
+}  // namespace zw101_sim
+
+namespace esphome {
+
+int sim_log_level = SIM_LOG_WARN;
+
+static ESPPreferences sim_preferences;
+ESPPreferences *global_preferences = &sim_preferences;
+
+uint32_t millis() { return static_cast<uint32_t>(zw101_sim::SimClock::now_us() / 1000); }
+uint32_t micros() { return static_cast<uint32_t>(zw101_sim::SimClock::now_us()); }
+
+// 组件内的阻塞延时同样消耗仿真时间
+void delay(uint32_t ms) { zw101_sim::SimClock::advance_us(static_cast<uint64_t>(ms) * 1000); }
+
+void sim_log(int level, const char *tag, const char *format, ...) {
+  if (level > sim_log_level)
+    return;
+  static const char LEVEL_CHARS[] = {' ', 'E', 'W', 'I', 'D'};
+  uint64_t now = zw101_sim::SimClock::now_us();
+  fprintf(stderr, "[%8.3f][%c][%s] ", now / 1000.0, LEVEL_CHARS[level], tag);
+  va_list args;
+  va_start(args, format);
+  vfprintf(stderr, format, args);
+  va_end(args);
+  fputc('\n', stderr);
+}
+
+void sim_log_hex(const char *tag, const uint8_t *data, int length) {
+  if (SIM_LOG_INFO > sim_log_level)
+    return;
+  fprintf(stderr, "[%8.3f][I][%s] ", zw101_sim::SimClock::now_us() / 1000.0, tag);
+  for (int i = 0; i < length; i++)
+    fprintf(stderr, "%02X ", data[i]);
+  fputc('\n', stderr);
+}
+
+}  // namespace esphome
+
+void yield() {}
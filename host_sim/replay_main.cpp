@@ -0,0 +1,267 @@
+// ZW101 串口会话录制与回放
+// - record: 用模组仿真器跑一段按压脚本, 把组件的收发跟踪保存为录像
+// - play:   用录像 (仿真录制或现场 dump_trace 日志) 驱动组件, 比较录制与回放的解锁延迟;
+//           录制与回放的解锁逐次配对, 有漏掉或多出的解锁时给出警告并以状态 2 退出
+// 回放运行在仿真时钟上, 与墙上时间无关; -s 改变的是录像时间轴的倍速
+//
+// 用法: zw101_replay record <out> [-b baud_rate] [-l loop_interval_ms] [-a]
+//       zw101_replay play <capture> [-s speed] [-b baud_rate] [-l loop_interval_ms] [-c capacity] [-o out] [-v]
+
+#include "capture.h"
+#include "replay_module.h"
+#include "sim_clock.h"
+#include "virtual_uart.h"
+#include "zw101.h"
+#include "zw101_sim.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using esphome::zw101::ZW101Component;
+using zw101_sim::Capture;
+using zw101_sim::ModuleSimulator;
+using zw101_sim::ReplayModule;
+using zw101_sim::SimClock;
+using zw101_sim::VirtualUART;
+
+namespace {
+
+const uint64_t SIM_TICK_US = 50;              // 仿真步长
+const size_t TRACE_BUFFER_SIZE = 1 << 20;     // 录制用跟踪缓冲区
+const uint64_t RECORD_DURATION_MS = 20000;
+const uint64_t PAIR_WINDOW_US = 1000000;      // 录制与回放的解锁按录像时间轴配对时允许的起点偏差
+
+struct Options {
+  uint32_t loop_interval_us{16000};
+  uint32_t baud_rate{0};  // 0: 录制时 57600, 回放时取录像中的波特率
+  double speed{1.0};
+  uint16_t capacity{50};
+  bool auto_match{false};
+  std::string output;
+};
+
+// 被测组件及其传感器; 模组由调用方提供, 每个仿真步调用其 poll()
+struct Host {
+  Host(const Options &options, VirtualUART *uart) : options(options) {
+    component.set_uart_parent(uart);
+    component.set_fingerprint_sensor(&match_sensor);
+    component.set_match_id_sensor(&match_id);
+    component.set_match_score_sensor(&match_score);
+    component.set_status_sensor(&status);
+    component.set_trace_buffer_size(TRACE_BUFFER_SIZE);
+  }
+
+  template<typename Module> void run_until_us(Module &module, uint64_t end_us) {
+    while (SimClock::now_us() < end_us) {
+      if (SimClock::now_us() >= next_loop_us) {
+        component.loop();
+        next_loop_us = SimClock::now_us() + options.loop_interval_us;
+      }
+      module.poll();
+      SimClock::advance_us(SIM_TICK_US);
+    }
+  }
+
+  Options options;
+  ZW101Component component;
+  esphome::binary_sensor::BinarySensor match_sensor;
+  esphome::sensor::Sensor match_id;
+  esphome::sensor::Sensor match_score;
+  esphome::text_sensor::TextSensor status;
+  uint64_t next_loop_us{0};
+};
+
+void print_latencies(const char *label, std::vector<double> samples) {
+  if (samples.empty()) {
+    printf("  %-28s no unlocks\n", label);
+    return;
+  }
+  std::sort(samples.begin(), samples.end());
+  double sum = 0;
+  for (double v : samples)
+    sum += v;
+  printf("  %-28s n=%-3zu min=%7.1f avg=%7.1f p50=%7.1f max=%7.1f ms\n", label, samples.size(), samples.front(),
+         sum / samples.size(), samples[samples.size() / 2], samples.back());
+}
+
+// 录制: 已注册手指按压6次, 中间夹一次未注册手指
+int record(const Options &options, const std::string &path) {
+  SimClock::reset();
+  VirtualUART uart;
+  uint32_t baud = options.baud_rate ? options.baud_rate : 57600;
+  uart.set_baud_rate(baud);
+  uart.set_module_baud_rate(baud);
+  ModuleSimulator module(&uart);
+  module.set_capacity(options.capacity);
+  module.enroll(3, 1001);
+  for (int i = 0; i < 7; i++) {
+    uint64_t press_ms = 3000 + i * 2300 + (i * 173) % 500;
+    module.add_touch(press_ms, press_ms + 700, i == 3 ? 2002 : 1001);
+  }
+
+  Host host(options, &uart);
+  host.component.setup();
+  if (options.auto_match) {
+    host.run_until_us(module, 1000000);
+    host.component.auto_match_mode();
+  }
+  host.run_until_us(module, RECORD_DURATION_MS * 1000);
+
+  Capture capture;
+  capture.set_baud_rate(baud);
+  capture.add_trace(host.component.get_trace());
+  if (!capture.save(path)) {
+    fprintf(stderr, "cannot write %s\n", path.c_str());
+    return 1;
+  }
+  printf("recorded %zu frames, %.1f s -> %s\n", capture.frames().size(), capture.duration_us() / 1e6, path.c_str());
+  print_latencies("unlock latency", zw101_sim::unlock_latencies_ms(capture));
+  return 0;
+}
+
+// 回放: 录像驱动组件, 回放结束后从组件自己的跟踪中提取同样的指标
+int play(const Options &options, const std::string &path) {
+  Capture recorded;
+  if (!recorded.load(path) || recorded.frames().empty()) {
+    fprintf(stderr, "cannot load capture %s\n", path.c_str());
+    return 1;
+  }
+
+  SimClock::reset();
+  VirtualUART uart;
+  uint32_t baud = options.baud_rate ? options.baud_rate : recorded.baud_rate();
+  uart.set_baud_rate(baud);
+  uart.set_module_baud_rate(baud);
+  ReplayModule module(&uart, recorded, options.speed);
+  module.set_capacity(options.capacity);
+
+  Host host(options, &uart);
+  host.component.setup();
+  // 录像中的会话若启动了自动验证, 回放时同样启动
+  bool auto_match = options.auto_match;
+  for (const auto &frame : recorded.frames()) {
+    if (frame.direction == esphome::zw101::FrameTrace::TRACE_TX && frame.data.size() > 9 && frame.data[9] == 0x32)
+      auto_match = true;
+  }
+  if (auto_match) {
+    host.run_until_us(module, 1000000);
+    host.component.auto_match_mode();
+  }
+  host.run_until_us(module, module.duration_us() + 2000000);
+
+  Capture replayed;
+  replayed.add_trace(host.component.get_trace());
+  printf("capture %s: %zu frames, %.1f s at %u baud, speed x%.2f\n", path.c_str(), recorded.frames().size(),
+         recorded.duration_us() / 1e6, baud, options.speed);
+  printf("  %-28s %u replayed, %u reused, %u fallback, %u truncated frames skipped\n", "module commands",
+         module.replayed_commands(), module.reused_commands(), module.fallback_commands(), module.skipped_frames());
+  print_latencies("recorded unlock latency", zw101_sim::unlock_latencies_ms(recorded));
+  print_latencies("replayed unlock latency", zw101_sim::unlock_latencies_ms(replayed));
+
+  // 按录像时间轴配对: 回放的仿真时间乘以倍速即录像中的位置, 每次录制的解锁取起点最接近的一次回放解锁
+  auto recorded_unlocks = zw101_sim::find_unlocks(recorded);
+  auto replayed_unlocks = zw101_sim::find_unlocks(replayed);
+  uint64_t origin = recorded.frames().front().time_us;
+  std::vector<bool> taken(replayed_unlocks.size(), false);
+  size_t paired = 0;
+  double change = 0;
+  for (const auto &unlock : recorded_unlocks) {
+    double position = static_cast<double>(unlock.start_us - origin);
+    int best = -1;
+    double best_distance = PAIR_WINDOW_US;
+    for (size_t i = 0; i < replayed_unlocks.size(); i++) {
+      double distance = std::abs(replayed_unlocks[i].start_us * options.speed - position);
+      if (!taken[i] && distance <= best_distance) {
+        best = static_cast<int>(i);
+        best_distance = distance;
+      }
+    }
+    if (best < 0)
+      continue;
+    taken[best] = true;
+    paired++;
+    change += replayed_unlocks[best].latency_ms - unlock.latency_ms;
+  }
+  if (paired > 0) {
+    printf("  %-28s %zu/%zu, avg change %+.1f ms\n", "paired unlocks", paired, recorded_unlocks.size(),
+           change / paired);
+  } else {
+    printf("  %-28s 0/%zu\n", "paired unlocks", recorded_unlocks.size());
+  }
+  printf("  %-28s %zu/%zu\n", "missed unlocks", recorded_unlocks.size() - paired, recorded_unlocks.size());
+  printf("  %-28s %zu\n", "extra unlocks", replayed_unlocks.size() - paired);
+  bool mismatch = paired != recorded_unlocks.size() || paired != replayed_unlocks.size();
+  if (mismatch) {
+    fprintf(stderr, "warning: %zu recorded unlocks, %zu replayed, %zu paired%s\n", recorded_unlocks.size(),
+            replayed_unlocks.size(), paired,
+            options.speed > 1 ? "; presses shorter than the poll interval are lost at this speed" : "");
+  }
+
+  const auto &stats = host.component.get_command_stats();
+  for (uint8_t i = 0; i < stats.size(); i++) {
+    const auto &latency = stats.at(i);
+    printf("  cmd 0x%02X round trip          n=%-3u avg=%7.1f p95=%7.1f max=%7.1f ms (queue %.1f ms, %u timeouts)\n",
+           latency.cmd, (unsigned) latency.count, latency.avg_us() / 1000.0, latency.percentile_us(95) / 1000.0,
+           latency.max_us / 1000.0, latency.avg_wait_us() / 1000.0, (unsigned) latency.timeouts);
+  }
+
+  if (!options.output.empty()) {
+    replayed.set_baud_rate(baud);
+    if (!replayed.save(options.output)) {
+      fprintf(stderr, "cannot write %s\n", options.output.c_str());
+      return 1;
+    }
+  }
+  return mismatch ? 2 : 0;
+}
+
+void usage(const char *prog) {
+  fprintf(stderr,
+          "usage: %s record <out> [-b baud_rate] [-l loop_interval_ms] [-a]\n"
+          "       %s play <capture> [-s speed] [-b baud_rate] [-l loop_interval_ms] [-c capacity] [-o out] [-v]\n",
+          prog, prog);
+  exit(1);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (argc < 3)
+    usage(argv[0]);
+  std::string mode = argv[1];
+  std::string path = argv[2];
+  Options options;
+
+  for (int i = 3; i < argc; i++) {
+    if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+      options.loop_interval_us = static_cast<uint32_t>(atof(argv[++i]) * 1000);
+    } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+      options.baud_rate = static_cast<uint32_t>(atoi(argv[++i]));
+    } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+      options.speed = atof(argv[++i]);
+    } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+      options.capacity = static_cast<uint16_t>(atoi(argv[++i]));
+    } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      options.output = argv[++i];
+    } else if (strcmp(argv[i], "-a") == 0) {
+      options.auto_match = true;
+    } else if (strcmp(argv[i], "-v") == 0) {
+      esphome::sim_log_level = esphome::SIM_LOG_DEBUG;
+    } else {
+      usage(argv[0]);
+    }
+  }
+  if (options.speed <= 0)
+    usage(argv[0]);
+
+  if (mode == "record")
+    return record(options, path);
+  if (mode == "play")
+    return play(options, path);
+  usage(argv[0]);
+}
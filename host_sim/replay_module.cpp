@@ -0,0 +1,173 @@
+#include "replay_module.h"
+#include "sim_clock.h"
+
+#include <cstring>
+
+namespace zw101_sim {
+
+using esphome::zw101::FrameParser;
+using esphome::zw101::FrameTrace;
+
+static const uint8_t CMD_GET_IMAGE = 0x01;
+static const uint8_t CMD_SEARCH = 0x04;
+static const uint8_t CMD_READ_SYSPARA = 0x0F;
+static const uint8_t CMD_READ_INDEX_TABLE = 0x1F;
+static const uint8_t CMD_GET_IMAGE_ENROLL = 0x29;
+static const uint8_t CMD_CHECK_FINGER = 0x9D;
+static const uint32_t FALLBACK_DELAY_US = 1000;
+// 录制的 RX 时间是组件在 loop 中解析完应答的时间, 应答实际在此之前已经到达;
+// 回放时提前一点发完, 保证在同一次 loop 中被读到
+static const uint32_t REPLY_LEAD_US = 1000;
+
+static std::vector<uint8_t> make_ack(uint8_t code, const std::vector<uint8_t> &params) {
+  uint16_t length = static_cast<uint16_t>(params.size() + 3);
+  std::vector<uint8_t> frame;
+  frame.reserve(params.size() + 12);
+  for (uint8_t byte : {0xEF, 0x01, 0xFF, 0xFF, 0xFF, 0xFF})
+    frame.push_back(byte);
+  frame.push_back(esphome::zw101::PKG_ACK);
+  frame.push_back(static_cast<uint8_t>(length >> 8));
+  frame.push_back(static_cast<uint8_t>(length));
+  frame.push_back(code);
+  for (uint8_t byte : params)
+    frame.push_back(byte);
+  uint16_t sum = 0;
+  for (size_t i = esphome::zw101::CALC_SUM_START_POS; i < frame.size(); i++)
+    sum += frame[i];
+  frame.push_back(static_cast<uint8_t>(sum >> 8));
+  frame.push_back(static_cast<uint8_t>(sum));
+  return frame;
+}
+
+ReplayModule::ReplayModule(VirtualUART *uart, const Capture &capture, double speed) : uart_(uart), speed_(speed) {
+  const auto &frames = capture.frames();
+  if (frames.empty())
+    return;
+  uint64_t start = frames.front().time_us;
+  duration_us_ = static_cast<uint64_t>(capture.duration_us() / speed_);
+
+  for (const auto &frame : frames) {
+    bool is_command = frame.direction == FrameTrace::TRACE_TX && frame.complete() && frame.length > 9 &&
+                      frame.data[6] == esphome::zw101::PKG_CMD;
+    if (is_command) {
+      exchanges_.push_back({frame.time_us - start, frame.data, {}});
+      continue;
+    }
+    if (frame.direction != FrameTrace::TRACE_RX || exchanges_.empty())
+      continue;
+    if (!frame.complete()) {
+      skipped_++;
+      continue;
+    }
+    Exchange &exchange = exchanges_.back();
+    exchange.replies.push_back({frame.time_us - start - exchange.time_us, frame.data});
+  }
+}
+
+void ReplayModule::poll() {
+  uint8_t data;
+  while (uart_->module_read(&data)) {
+    if (parser_.feed(data) == FrameParser::FRAME_COMPLETE)
+      handle_command(parser_.data(), parser_.size());
+  }
+
+  uint64_t now = SimClock::now_us();
+  while (!scheduled_.empty() && scheduled_.front().due_us <= now) {
+    uart_->module_write(scheduled_.front().frame.data(), scheduled_.front().frame.size());
+    scheduled_.pop_front();
+  }
+}
+
+void ReplayModule::schedule(uint64_t due_us, std::vector<uint8_t> frame) {
+  auto it = scheduled_.end();
+  while (it != scheduled_.begin() && (it - 1)->due_us > due_us)
+    --it;
+  scheduled_.insert(it, {due_us, std::move(frame)});
+}
+
+ReplayModule::Exchange *ReplayModule::find_exchange(const uint8_t *frame, uint16_t length) {
+  // 录像时间轴上的当前位置
+  uint64_t position = static_cast<uint64_t>(SimClock::now_us() * speed_);
+  Exchange *best = nullptr;
+  int best_rank = 0;
+  uint64_t best_distance = 0;
+
+  for (auto &exchange : exchanges_) {
+    if (exchange.command[esphome::zw101::CMD_CODE_START_POS] != frame[esphome::zw101::CMD_CODE_START_POS])
+      continue;
+    // 整帧相同 (参数也相同) 的交互优先, 其次只是指令码相同; 同级取时间最接近的
+    bool same = exchange.command.size() == length && memcmp(exchange.command.data(), frame, length) == 0;
+    int rank = same ? 2 : 1;
+    uint64_t distance = exchange.time_us > position ? exchange.time_us - position : position - exchange.time_us;
+    if (best == nullptr || rank > best_rank || (rank == best_rank && distance < best_distance)) {
+      best = &exchange;
+      best_rank = rank;
+      best_distance = distance;
+    }
+  }
+  return best;
+}
+
+void ReplayModule::handle_command(const uint8_t *frame, uint16_t length) {
+  if (frame[6] != esphome::zw101::PKG_CMD)
+    return;
+
+  Exchange *exchange = find_exchange(frame, length);
+  if (exchange == nullptr) {
+    fallback_++;
+    fallback_reply(frame[esphome::zw101::CMD_CODE_START_POS], frame + esphome::zw101::VARIABLE_FIELD_START_POS);
+    return;
+  }
+  if (exchange->used) {
+    reused_++;
+  } else {
+    replayed_++;
+    exchange->used = true;
+  }
+
+  // 录制的间隔包含指令和应答在线上的时间, 回放时由虚拟串口重新计入
+  uint64_t now = SimClock::now_us();
+  uint64_t byte_us = VirtualUART::byte_time_us(uart_->get_module_baud_rate());
+  for (const auto &reply : exchange->replies) {
+    uint64_t wire_us = (length + reply.frame.size()) * byte_us + REPLY_LEAD_US;
+    uint64_t offset = static_cast<uint64_t>(reply.offset_us / speed_);
+    schedule(now + (offset > wire_us ? offset - wire_us : 0), reply.frame);
+  }
+}
+
+void ReplayModule::fallback_reply(uint8_t cmd, const uint8_t *params) {
+  uint64_t due = SimClock::now_us() + FALLBACK_DELAY_US;
+  switch (cmd) {
+    case CMD_READ_SYSPARA:
+      schedule(due, make_ack(0x00, {0x00, 0x00, 0x00, 0x09, static_cast<uint8_t>(capacity_ >> 8),
+                                    static_cast<uint8_t>(capacity_), 0x00, 0x03, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x02,
+                                    0x00, static_cast<uint8_t>(uart_->get_module_baud_rate() / 9600)}));
+      break;
+
+    case CMD_READ_INDEX_TABLE: {
+      // 不知道现场指纹库的占用情况, 按全部占用处理, 搜索覆盖整个容量
+      std::vector<uint8_t> table(32, 0);
+      uint16_t base = params[0] * 256;
+      for (uint16_t page = base; page < capacity_ && page < base + 256; page++)
+        table[(page - base) / 8] |= 1 << (page % 8);
+      schedule(due, make_ack(0x00, table));
+      break;
+    }
+
+    case CMD_GET_IMAGE:
+    case CMD_GET_IMAGE_ENROLL:
+    case CMD_CHECK_FINGER:
+      schedule(due, make_ack(0x02, {}));
+      break;
+
+    case CMD_SEARCH:
+      schedule(due, make_ack(0x09, {0x00, 0x00, 0x00, 0x00}));
+      break;
+
+    default:
+      schedule(due, make_ack(0x00, {}));
+      break;
+  }
+}
+
+}  // namespace zw101_sim
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "capture.h"
+#include "virtual_uart.h"
+#include "zw101_protocol.h"
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace zw101_sim {
+
+// 录像回放模组: 代替 ModuleSimulator 接在虚拟串口上, 用录制的应答驱动组件
+// - 录像按指令切分为交互: 一条 TX 指令及其后直到下一条指令之前收到的全部 RX 帧
+// - 收到组件的指令时, 在指令相同 (其次指令码相同) 的交互中选录制时间与当前回放时间最接近的一个,
+//   按录制时相对指令的时间发出其中的 RX 帧; 组件改了调度或状态机后,
+//   手指何时按下、模组处理多久仍与现场一致
+// - speed 为回放倍速: 录像时间轴和模组处理时间都除以 speed
+// - 录像中没有对应交互的指令 (例如环形缓冲区未覆盖的启动阶段) 由内置的缺省应答处理:
+//   读参数返回 capacity, 读索引表返回全部占用, 采图和检查手指返回无手指, 搜索返回未找到, 其余返回成功
+class ReplayModule {
+ public:
+  ReplayModule(VirtualUART *uart, const Capture &capture, double speed = 1.0);
+
+  void set_capacity(uint16_t capacity) { capacity_ = capacity; }
+
+  // 每个仿真步调用: 接收指令, 发出到期的应答
+  void poll();
+
+  uint64_t duration_us() const { return duration_us_; }
+  uint32_t replayed_commands() const { return replayed_; }
+  uint32_t reused_commands() const { return reused_; }      // 选中的交互之前已经回放过
+  uint32_t fallback_commands() const { return fallback_; }  // 录像中没有该指令
+  uint32_t skipped_frames() const { return skipped_; }      // 被截断、无法回放的 RX 帧
+
+ protected:
+  struct Reply {
+    uint64_t offset_us;  // 相对指令发出的时间
+    std::vector<uint8_t> frame;
+  };
+  struct Exchange {
+    uint64_t time_us;  // 指令发出时间, 相对录像开始
+    std::vector<uint8_t> command;
+    std::vector<Reply> replies;
+    bool used{false};
+  };
+  struct Scheduled {
+    uint64_t due_us;
+    std::vector<uint8_t> frame;
+  };
+
+  void handle_command(const uint8_t *frame, uint16_t length);
+  Exchange *find_exchange(const uint8_t *frame, uint16_t length);
+  void fallback_reply(uint8_t cmd, const uint8_t *params);
+  void schedule(uint64_t due_us, std::vector<uint8_t> frame);
+
+  VirtualUART *uart_;
+  esphome::zw101::FrameParser parser_;
+  std::vector<Exchange> exchanges_;
+  std::deque<Scheduled> scheduled_;
+  double speed_;
+  uint64_t duration_us_{0};
+  uint16_t capacity_{50};
+
+  uint32_t replayed_{0};
+  uint32_t reused_{0};
+  uint32_t fallback_{0};
+  uint32_t skipped_{0};
+};
+
+}  // namespace zw101_sim
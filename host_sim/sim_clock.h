@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+
+namespace zw101_sim {
+
+// 仿真时钟: millis()/micros()/delay() 都由它驱动, 单位微秒
+class SimClock {
+ public:
+  static uint64_t now_us() { return now_us_; }
+  static void advance_us(uint64_t us) { now_us_ += us; }
+  static void reset() { now_us_ = 0; }
+
+ protected:
+  static uint64_t now_us_;
+};
+
+}  // namespace zw101_sim
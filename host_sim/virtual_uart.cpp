@@ -0,0 +1,95 @@
+#include "virtual_uart.h"
+#include "sim_clock.h"
+
+namespace zw101_sim {
+
+void VirtualUART::transmit(Lane &lane, const uint8_t *data, size_t len, uint32_t tx_baud, uint32_t rx_baud) {
+  uint64_t now = SimClock::now_us();
+  uint64_t t = lane.line_free_at_us > now ? lane.line_free_at_us : now;
+  uint64_t per_byte = byte_time_us(tx_baud);
+  for (size_t i = 0; i < len; i++) {
+    t += per_byte;
+    uint8_t byte = data[i];
+    if (tx_baud != rx_baud)
+      byte = static_cast<uint8_t>(byte ^ 0xA5);  // 波特率不匹配, 接收端只能得到乱码
+    lane.bytes.emplace_back(t, byte);
+  }
+  lane.line_free_at_us = t;
+}
+
+int VirtualUART::arrived(const Lane &lane) {
+  uint64_t now = SimClock::now_us();
+  int count = 0;
+  for (const auto &entry : lane.bytes) {
+    if (entry.first > now)
+      break;
+    count++;
+  }
+  return count;
+}
+
+void VirtualUART::write_array(const uint8_t *data, size_t len) {
+  for (auto &lane : to_module_)
+    transmit(lane, data, len, baud_rate_, module_baud_rate_);
+  bytes_to_module_ += len;
+}
+
+bool VirtualUART::peek_byte(uint8_t *data) {
+  if (arrived(to_host_) == 0)
+    return false;
+  *data = to_host_.bytes.front().second;
+  return true;
+}
+
+bool VirtualUART::read_array(uint8_t *data, size_t len) {
+  if (static_cast<size_t>(arrived(to_host_)) < len)
+    return false;
+  for (size_t i = 0; i < len; i++) {
+    data[i] = to_host_.bytes.front().second;
+    to_host_.bytes.pop_front();
+  }
+  return true;
+}
+
+int VirtualUART::available() { return arrived(to_host_); }
+
+// 与真实硬件一致: 阻塞到发送完成
+void VirtualUART::flush() {
+  uint64_t now = SimClock::now_us();
+  if (to_module_[0].line_free_at_us > now)
+    SimClock::advance_us(to_module_[0].line_free_at_us - now);
+}
+
+void VirtualUART::module_write(const uint8_t *data, size_t len) {
+  if (corrupt_at_ >= bytes_to_host_ && corrupt_at_ - bytes_to_host_ < len) {
+    std::vector<uint8_t> noisy(data, data + len);
+    noisy[corrupt_at_ - bytes_to_host_] ^= 0x01;
+    corrupt_at_ = UINT64_MAX;
+    transmit(to_host_, noisy.data(), len, module_baud_rate_, baud_rate_);
+  } else {
+    transmit(to_host_, data, len, module_baud_rate_, baud_rate_);
+  }
+  bytes_to_host_ += len;
+}
+
+bool VirtualUART::module_read(uint8_t *data, size_t tap) {
+  Lane &lane = to_module_[tap];
+  if (arrived(lane) == 0)
+    return false;
+  *data = lane.bytes.front().second;
+  lane.bytes.pop_front();
+  return true;
+}
+
+size_t VirtualUART::add_module_tap() {
+  to_module_.emplace_back();
+  return to_module_.size() - 1;
+}
+
+uint64_t VirtualUART::next_module_arrival_us(size_t tap) const {
+  if (to_module_[tap].bytes.empty())
+    return UINT64_MAX;
+  return to_module_[tap].bytes.front().first;
+}
+
+}  // namespace zw101_sim
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "esphome/components/uart/uart.h"
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace zw101_sim {
+
+// 虚拟串口: 作为组件的 uart::UARTComponent, 另一端接模组仿真器
+// 每个字节按 10bit/波特率 计算线上传输时间, 到达时间之前对端读不到;
+// 两端波特率不一致时, 到达的字节被破坏 (模拟真实串口的乱码)
+// 多个模组可以通过收发器接在同一个串口上: 每个模组一个接收端 (tap), 组件发出的字节到达所有接收端,
+// 模组的应答在同一条线上依次发出
+class VirtualUART : public esphome::uart::UARTComponent {
+ public:
+  // 组件侧
+  void write_array(const uint8_t *data, size_t len) override;
+  bool peek_byte(uint8_t *data) override;
+  bool read_array(uint8_t *data, size_t len) override;
+  int available() override;
+  void flush() override;
+
+  // 模组侧
+  void set_module_baud_rate(uint32_t baud_rate) { module_baud_rate_ = baud_rate; }
+  uint32_t get_module_baud_rate() const { return module_baud_rate_; }
+  void module_write(const uint8_t *data, size_t len);
+  bool module_read(uint8_t *data, size_t tap = 0);
+  size_t add_module_tap();  // 返回新接收端的编号
+  // 下一个发往模组的字节到达时间, 没有字节时返回 UINT64_MAX
+  uint64_t next_module_arrival_us(size_t tap = 0) const;
+  // 线路干扰: 模组发出的第 offset 个字节 (按 bytes_to_host() 计数) 到达时被破坏, 只生效一次
+  void corrupt_to_host(uint64_t offset) { corrupt_at_ = offset; }
+
+  // 统计
+  uint64_t bytes_to_module() const { return bytes_to_module_; }
+  uint64_t bytes_to_host() const { return bytes_to_host_; }
+
+  static uint64_t byte_time_us(uint32_t baud_rate) { return 10000000ULL / baud_rate; }
+
+ protected:
+  struct Lane {
+    std::deque<std::pair<uint64_t, uint8_t>> bytes;  // (到达时间, 数据)
+    uint64_t line_free_at_us{0};
+  };
+
+  void transmit(Lane &lane, const uint8_t *data, size_t len, uint32_t tx_baud, uint32_t rx_baud);
+  static int arrived(const Lane &lane);
+
+  std::vector<Lane> to_module_{1};
+  Lane to_host_;
+  uint32_t module_baud_rate_{57600};
+  uint64_t bytes_to_module_{0};
+  uint64_t bytes_to_host_{0};
+  uint64_t corrupt_at_{UINT64_MAX};
+};
+
+}  // namespace zw101_sim
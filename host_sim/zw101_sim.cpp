@@ -0,0 +1,588 @@
+#include "zw101_sim.h"
+#include "sim_clock.h"
+
+namespace zw101_sim {
+
+using esphome::zw101::FrameParser;
+
+// 指令码
+static const uint8_t CMD_GET_IMAGE = 0x01;
+static const uint8_t CMD_GEN_CHAR = 0x02;
+static const uint8_t CMD_MATCH = 0x03;
+static const uint8_t CMD_SEARCH = 0x04;
+static const uint8_t CMD_REG_MODEL = 0x05;
+static const uint8_t CMD_STORE_CHAR = 0x06;
+static const uint8_t CMD_LOAD_CHAR = 0x07;
+static const uint8_t CMD_UP_CHAR = 0x08;
+static const uint8_t CMD_DOWN_CHAR = 0x09;
+static const uint8_t CMD_DEL_CHAR = 0x0C;
+static const uint8_t CMD_CLEAR_LIB = 0x0D;
+static const uint8_t CMD_WRITE_REG = 0x0E;
+static const uint8_t CMD_READ_SYSPARA = 0x0F;
+static const uint8_t CMD_SET_CHIP_ADDR = 0x15;
+static const uint8_t CMD_READ_VALID_NUMS = 0x1D;
+static const uint8_t CMD_READ_INDEX_TABLE = 0x1F;
+static const uint8_t CMD_GET_IMAGE_ENROLL = 0x29;
+static const uint8_t CMD_AUTO_CANCEL = 0x30;
+static const uint8_t CMD_AUTO_ENROLL = 0x31;
+static const uint8_t CMD_AUTO_MATCH = 0x32;
+static const uint8_t CMD_INTO_SLEEP = 0x33;
+static const uint8_t CMD_HANDSHAKE = 0x35;
+static const uint8_t CMD_RGB_CTRL = 0x3C;
+static const uint8_t CMD_CHECK_FINGER = 0x9D;
+
+// 自动注册阶段 (PS_AutoEnroll 应答参数1)
+static const uint8_t STAGE_LEGALITY = 0x00;
+static const uint8_t STAGE_GET_IMAGE = 0x01;
+static const uint8_t STAGE_GEN_CHAR = 0x02;
+static const uint8_t STAGE_FINGER_LEAVE = 0x03;
+static const uint8_t STAGE_MERGE = 0x04;
+static const uint8_t STAGE_DUPLICATE = 0x05;
+static const uint8_t STAGE_STORE = 0x06;
+// 自动验证阶段 (PS_AutoIdentify 应答参数)
+static const uint8_t STAGE_SEARCH = 0x05;
+
+// 自动注册参数位 (PS_AutoEnroll 参数)
+static const uint16_t AUTO_ENROLL_NO_DUPLICATE = 1 << 4;  // 1: 不允许重复注册 (查重)
+static const uint16_t AUTO_ENROLL_NO_LIFT = 1 << 5;       // 1: 采集之间不要求手指离开
+
+static const uint64_t AUTO_STEP_TIMEOUT_US = 10000000;  // 自动注册每步等待手指的超时
+static const uint8_t ACK_TIME_OUT = 0x26;
+
+static const uint16_t MATCH_SCORE = 120;
+static const uint8_t REG_BAUD_RATE = 4;  // 系统寄存器: 波特率控制 N (N x 9600)
+static const uint32_t DEFAULT_BAUD_RATE = 57600;
+
+ModuleSimulator::ModuleSimulator(VirtualUART *uart, size_t tap) : uart_(uart), tap_(tap) {
+  // 缺省处理耗时, 量级参考实测: 采图和特征提取占大头
+  delays_us_[CMD_GET_IMAGE] = 80000;
+  delays_us_[CMD_GET_IMAGE_ENROLL] = 80000;
+  delays_us_[CMD_GEN_CHAR] = 120000;
+  delays_us_[CMD_MATCH] = 20000;
+  delays_us_[CMD_SEARCH] = 10000;  // 另加每页 search_page_cost_us_
+  delays_us_[CMD_REG_MODEL] = 60000;
+  delays_us_[CMD_STORE_CHAR] = 30000;
+  delays_us_[CMD_LOAD_CHAR] = 20000;
+  delays_us_[CMD_DEL_CHAR] = 20000;
+  delays_us_[CMD_CLEAR_LIB] = 50000;
+  delays_us_[CMD_CHECK_FINGER] = 2000;  // 只读触摸检测, 不采图
+}
+
+void TouchOutPin::update(bool level) {
+  if (level == level_)
+    return;
+  level_ = level;
+  bool rising = level;
+  if (isr_ != nullptr && (isr_type_ == esphome::gpio::INTERRUPT_ANY_EDGE ||
+                          (rising ? isr_type_ == esphome::gpio::INTERRUPT_RISING_EDGE
+                                  : isr_type_ == esphome::gpio::INTERRUPT_FALLING_EDGE)))
+    isr_(isr_arg_);
+}
+
+void TouchOutPin::attach_interrupt(void (*func)(void *), void *arg, esphome::gpio::InterruptType type) const {
+  isr_ = func;
+  isr_arg_ = arg;
+  isr_type_ = type;
+}
+
+void ModuleSimulator::add_touch(uint64_t start_ms, uint64_t end_ms, uint32_t finger) {
+  touches_.push_back({start_ms * 1000, end_ms * 1000, finger});
+}
+
+uint32_t ModuleSimulator::finger_at(uint64_t now_us) const {
+  for (const auto &touch : touches_) {
+    if (now_us >= touch.start_us && now_us < touch.end_us)
+      return touch.finger;
+  }
+  return 0;
+}
+
+uint32_t ModuleSimulator::delay_for(uint8_t cmd) const {
+  auto it = delays_us_.find(cmd);
+  return it == delays_us_.end() ? 1000 : it->second;
+}
+
+uint32_t ModuleSimulator::command_count(uint8_t cmd) const {
+  auto it = command_counts_.find(cmd);
+  return it == command_counts_.end() ? 0 : it->second;
+}
+
+bool ModuleSimulator::library_contains(uint32_t finger, uint16_t start, uint16_t count, uint16_t *page) const {
+  for (auto it = library_.lower_bound(start); it != library_.end() && it->first < start + count; ++it) {
+    if (it->second == finger) {
+      *page = it->first;
+      return true;
+    }
+  }
+  return false;
+}
+
+std::vector<uint8_t> ModuleSimulator::make_template(uint32_t finger) {
+  std::vector<uint8_t> data(TEMPLATE_SIZE);
+  data[0] = finger >> 24;
+  data[1] = finger >> 16;
+  data[2] = finger >> 8;
+  data[3] = finger;
+  for (uint16_t i = 4; i < TEMPLATE_SIZE; i++)
+    data[i] = static_cast<uint8_t>(finger * 31 + i * 7);
+  return data;
+}
+
+// 应答在模组空闲后再处理 delay_us 才发出
+void ModuleSimulator::reply(uint32_t delay_us, uint8_t code, const std::vector<uint8_t> &params) {
+  std::vector<uint8_t> payload = {code};
+  payload.insert(payload.end(), params.begin(), params.end());
+  send_packet(delay_us, esphome::zw101::PKG_ACK, payload);
+}
+
+void ModuleSimulator::send_packet(uint32_t delay_us, uint8_t pid, const std::vector<uint8_t> &payload) {
+  uint64_t now = SimClock::now_us();
+  uint64_t start = busy_until_us_ > now ? busy_until_us_ : now;
+  busy_until_us_ = start + delay_us;
+  busy_us_ += delay_us;
+
+  uint16_t length = static_cast<uint16_t>(payload.size() + 2);
+  std::vector<uint8_t> frame = {0xEF, 0x01, 0, 0, 0, 0, pid, static_cast<uint8_t>(length >> 8),
+                                static_cast<uint8_t>(length)};
+  esphome::zw101::write_address(frame.data(), address_);
+  frame.insert(frame.end(), payload.begin(), payload.end());
+  uint16_t sum = 0;
+  for (size_t i = esphome::zw101::CALC_SUM_START_POS; i < frame.size(); i++)
+    sum += frame[i];
+  frame.push_back(static_cast<uint8_t>(sum >> 8));
+  frame.push_back(static_cast<uint8_t>(sum));
+
+  replies_.push_back({busy_until_us_, std::move(frame)});
+}
+
+void ModuleSimulator::poll() {
+  uint64_t now = SimClock::now_us();
+  touch_pin_.update(finger_at(now) != 0);
+
+  // 休眠中手指按下: 模组上电, wake_time 后才能响应指令
+  if (asleep_ && wake_at_us_ == 0 && finger_at(now) != 0)
+    wake_at_us_ = now + wake_time_us_;
+  if (asleep_ && wake_at_us_ != 0 && now >= wake_at_us_) {
+    asleep_ = false;
+    wake_at_us_ = 0;
+    asleep_total_us_ += now - sleep_start_us_;
+  }
+
+  // 接收指令
+  uint8_t data;
+  while (uart_->module_read(&data, tap_)) {
+    switch (parser_.feed(data)) {
+      case FrameParser::FRAME_COMPLETE:
+        handle_command(parser_.data(), parser_.size());
+        break;
+      case FrameParser::FRAME_BAD_CHECKSUM:
+        if (!asleep_)
+          reply(delay_for(0), ACK_COMM_ERR);
+        break;
+      default:
+        break;
+    }
+  }
+
+  // 发出到期的应答
+  while (!replies_.empty() && replies_.front().ready_at_us <= now) {
+    const auto &reply = replies_.front();
+    uart_->module_write(reply.frame.data(), reply.frame.size());
+    if (reply.baud_after != 0)
+      uart_->set_module_baud_rate(reply.baud_after);
+    replies_.pop_front();
+  }
+
+  if (auto_mode_ != AUTO_NONE && replies_.empty() && busy_until_us_ <= now)
+    process_auto_mode();
+}
+
+uint64_t ModuleSimulator::asleep_us() const {
+  return asleep_total_us_ + (asleep_ ? SimClock::now_us() - sleep_start_us_ : 0);
+}
+
+void ModuleSimulator::power_cycle() {
+  replies_.clear();
+  parser_.reset();
+  busy_until_us_ = SimClock::now_us();
+  image_ = 0;
+  for (auto &buffer : char_buffers_)
+    buffer = 0;
+  download_buffer_ = 0;
+  if (asleep_)
+    asleep_total_us_ += SimClock::now_us() - sleep_start_us_;
+  asleep_ = false;
+  wake_at_us_ = 0;
+  auto_mode_ = AUTO_NONE;
+  uart_->set_module_baud_rate(baud_persistent_ ? stored_baud_rate_ : DEFAULT_BAUD_RATE);
+}
+
+// 下载数据: 收齐结束包后校验内容, 不完整或内容不符时缓冲区作废
+void ModuleSimulator::receive_data_packet(const uint8_t *frame, uint16_t length) {
+  const uint8_t *payload = frame + esphome::zw101::FRAME_HEAD_SIZE;
+  download_data_.insert(download_data_.end(), payload, payload + length - esphome::zw101::FRAME_HEAD_SIZE - 2);
+  if (frame[6] != esphome::zw101::PKG_EOF)
+    return;
+
+  uint32_t finger = 0;
+  if (download_data_.size() >= 4)
+    finger = (static_cast<uint32_t>(download_data_[0]) << 24) | (static_cast<uint32_t>(download_data_[1]) << 16) |
+             (static_cast<uint32_t>(download_data_[2]) << 8) | download_data_[3];
+  char_buffers_[download_buffer_] = download_data_ == make_template(finger) ? finger : 0;
+  download_buffer_ = 0;
+  download_data_.clear();
+}
+
+void ModuleSimulator::handle_command(const uint8_t *frame, uint16_t length) {
+  // 共享总线上发给其他模组的帧, 不响应
+  if (esphome::zw101::read_address(frame) != address_)
+    return;
+  if (download_buffer_ != 0 && (frame[6] == esphome::zw101::PKG_DATA || frame[6] == esphome::zw101::PKG_EOF)) {
+    receive_data_packet(frame, length);
+    return;
+  }
+  if (frame[6] != esphome::zw101::PKG_CMD)
+    return;
+  download_buffer_ = 0;  // 下载中途收到指令: 放弃下载
+  // 休眠中的模组不响应指令, 需要手指按压唤醒
+  if (asleep_)
+    return;
+
+  uint8_t cmd = frame[9];
+  const uint8_t *p = frame + esphome::zw101::VARIABLE_FIELD_START_POS;
+  uint16_t param_len = length - esphome::zw101::FRAME_HEAD_SIZE - 3;
+  uint32_t delay = delay_for(cmd);
+  uint64_t now = SimClock::now_us();
+
+  command_counts_[cmd]++;
+  total_commands_++;
+
+  // 自动模式下模组只接受取消指令
+  if (auto_mode_ != AUTO_NONE && cmd != CMD_AUTO_CANCEL) {
+    reply(delay, ACK_COMM_ERR);
+    return;
+  }
+
+  switch (cmd) {
+    case CMD_GET_IMAGE:
+    case CMD_GET_IMAGE_ENROLL: {
+      image_ = finger_at(now);
+      reply(delay, image_ != 0 ? ACK_OK : ACK_NO_FINGER);
+      break;
+    }
+
+    case CMD_CHECK_FINGER:
+      if (!check_finger_supported_) {
+        reply(delay, ACK_COMM_ERR);
+        break;
+      }
+      reply(delay, finger_at(now) != 0 ? ACK_OK : ACK_NO_FINGER);
+      break;
+
+    case CMD_GEN_CHAR: {
+      uint8_t buffer_id = param_len >= 1 ? p[0] : 1;
+      if (buffer_id < 1 || buffer_id > 5) {
+        reply(delay, ACK_COMM_ERR);
+      } else if (image_ == 0) {
+        reply(delay, ACK_INVALID_IMAGE);
+      } else {
+        char_buffers_[buffer_id] = image_;
+        reply(delay, ACK_OK);
+      }
+      break;
+    }
+
+    case CMD_MATCH:
+      // 比对缓冲区1与缓冲区2
+      if (char_buffers_[1] != 0 && char_buffers_[1] == char_buffers_[2]) {
+        reply(delay, ACK_OK, {MATCH_SCORE >> 8, MATCH_SCORE & 0xFF});
+      } else {
+        reply(delay, ACK_NOT_MATCH, {0, 0});
+      }
+      break;
+
+    case CMD_SEARCH: {
+      uint8_t buffer_id = p[0];
+      uint16_t start = (p[1] << 8) | p[2];
+      uint16_t count = (p[3] << 8) | p[4];
+      uint16_t page;
+      if (buffer_id >= 1 && buffer_id <= 5 && char_buffers_[buffer_id] != 0 &&
+          library_contains(char_buffers_[buffer_id], start, count, &page)) {
+        // 按页号顺序比对, 找到即停
+        uint32_t search_delay = delay + search_page_cost_us_ * (page - start + 1);
+        reply(search_delay, ACK_OK,
+              {static_cast<uint8_t>(page >> 8), static_cast<uint8_t>(page), MATCH_SCORE >> 8, MATCH_SCORE & 0xFF});
+      } else {
+        reply(delay + search_page_cost_us_ * count, ACK_NOT_SEARCHED, {0, 0, 0, 0});
+      }
+      break;
+    }
+
+    case CMD_REG_MODEL: {
+      // 所有已生成的特征必须来自同一手指
+      uint32_t finger = char_buffers_[1];
+      bool ok = finger != 0;
+      for (int i = 2; i <= 5; i++) {
+        if (char_buffers_[i] != 0 && char_buffers_[i] != finger)
+          ok = false;
+      }
+      reply(delay, ok ? ACK_OK : ACK_MERGE_ERR);
+      break;
+    }
+
+    case CMD_STORE_CHAR: {
+      uint8_t buffer_id = p[0];
+      uint16_t page = (p[1] << 8) | p[2];
+      if (page >= capacity_) {
+        reply(delay, ACK_ADDRESS_OVER);
+      } else if (buffer_id < 1 || buffer_id > 5 || char_buffers_[buffer_id] == 0) {
+        reply(delay, ACK_COMM_ERR);
+      } else {
+        library_[page] = char_buffers_[buffer_id];
+        reply(delay, ACK_OK);
+      }
+      break;
+    }
+
+    case CMD_LOAD_CHAR: {
+      uint8_t buffer_id = p[0];
+      uint16_t page = (p[1] << 8) | p[2];
+      auto it = library_.find(page);
+      if (page >= capacity_) {
+        reply(delay, ACK_ADDRESS_OVER);
+      } else if (buffer_id < 1 || buffer_id > 5 || it == library_.end()) {
+        reply(delay, ACK_READ_TEMPLATE_ERR);
+      } else {
+        char_buffers_[buffer_id] = it->second;
+        reply(delay, ACK_OK);
+      }
+      break;
+    }
+
+    case CMD_UP_CHAR: {
+      // 应答之后紧接着发出数据包, 最后一包为结束包
+      uint8_t buffer_id = p[0];
+      if (buffer_id < 1 || buffer_id > 5 || char_buffers_[buffer_id] == 0) {
+        reply(delay, ACK_UPLOAD_ERR);
+        break;
+      }
+      reply(delay, ACK_OK);
+      std::vector<uint8_t> data = make_template(char_buffers_[buffer_id]);
+      for (size_t offset = 0; offset < data.size(); offset += DATA_PACKET_SIZE) {
+        bool last = offset + DATA_PACKET_SIZE >= data.size();
+        send_packet(0, last ? esphome::zw101::PKG_EOF : esphome::zw101::PKG_DATA,
+                    std::vector<uint8_t>(data.begin() + offset, last ? data.end() : data.begin() + offset + DATA_PACKET_SIZE));
+      }
+      break;
+    }
+
+    case CMD_DOWN_CHAR: {
+      uint8_t buffer_id = p[0];
+      if (buffer_id < 1 || buffer_id > 5) {
+        reply(delay, ACK_COMM_ERR);
+        break;
+      }
+      reply(delay, ACK_OK);
+      download_buffer_ = buffer_id;
+      download_data_.clear();
+      break;
+    }
+
+    case CMD_DEL_CHAR: {
+      uint16_t page = (p[0] << 8) | p[1];
+      uint16_t count = (p[2] << 8) | p[3];
+      if (page + count > capacity_) {
+        reply(delay, ACK_ADDRESS_OVER);
+      } else {
+        library_.erase(library_.lower_bound(page), library_.lower_bound(page + count));
+        reply(delay, ACK_OK);
+      }
+      break;
+    }
+
+    case CMD_CLEAR_LIB:
+      library_.clear();
+      reply(delay, ACK_OK);
+      break;
+
+    case CMD_WRITE_REG: {
+      // 只支持波特率寄存器, N 取 1~12; 应答仍用旧波特率发出, 之后立即切换
+      uint8_t reg = p[0];
+      uint8_t value = param_len >= 2 ? p[1] : 0;
+      if (reg != REG_BAUD_RATE || value < 1 || value > 12) {
+        reply(delay, 0x1A);  // PS_INVALID_REG
+        break;
+      }
+      reply(delay, ACK_OK);
+      replies_.back().baud_after = value * 9600;
+      stored_baud_rate_ = value * 9600;
+      break;
+    }
+
+    case CMD_READ_SYSPARA:
+      // 状态寄存器(2) 传感器类型(2) 库容量(2) 安全等级(2) 地址(4) 包大小(2) 波特率N(2)
+      reply(delay, ACK_OK,
+            {0x00, 0x00, 0x00, 0x09, static_cast<uint8_t>(capacity_ >> 8), static_cast<uint8_t>(capacity_), 0x00,
+             0x03, static_cast<uint8_t>(address_ >> 24), static_cast<uint8_t>(address_ >> 16),
+             static_cast<uint8_t>(address_ >> 8), static_cast<uint8_t>(address_), 0x00, 0x02, 0x00,
+             static_cast<uint8_t>(uart_->get_module_baud_rate() / 9600)});
+      break;
+
+    case CMD_SET_CHIP_ADDR:
+      // 新地址立即生效, 应答已使用新地址
+      if (param_len < 4) {
+        reply(delay, ACK_COMM_ERR);
+        break;
+      }
+      address_ = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+      reply(delay, ACK_OK);
+      break;
+
+    case CMD_READ_VALID_NUMS: {
+      uint16_t count = static_cast<uint16_t>(library_.size());
+      reply(delay, ACK_OK, {static_cast<uint8_t>(count >> 8), static_cast<uint8_t>(count)});
+      break;
+    }
+
+    case CMD_READ_INDEX_TABLE: {
+      uint8_t index = param_len >= 1 ? p[0] : 0;
+      std::vector<uint8_t> table(32, 0);
+      for (const auto &entry : library_) {
+        int bit = entry.first - index * 256;
+        if (bit >= 0 && bit < 256)
+          table[bit / 8] |= 1 << (bit % 8);
+      }
+      reply(delay, ACK_OK, table);
+      break;
+    }
+
+    case CMD_AUTO_CANCEL:
+      auto_mode_ = AUTO_NONE;
+      reply(delay, ACK_OK);
+      break;
+
+    case CMD_AUTO_ENROLL:
+      // ID(2) 录入次数(1) 参数(2); 旧格式缺少录入次数时按5次处理
+      auto_page_ = (p[0] << 8) | p[1];
+      auto_count_ = param_len >= 3 && p[2] != 0 ? p[2] : 5;
+      auto_param_ = param_len >= 5 ? (p[3] << 8) | p[4] : 0;
+      auto_step_ = 1;
+      auto_wait_lift_ = false;
+      auto_finger_ = 0;
+      auto_deadline_us_ = now + AUTO_STEP_TIMEOUT_US;
+      auto_mode_ = AUTO_ENROLL;
+      reply(delay, ACK_OK, {STAGE_LEGALITY, 0x00});
+      break;
+
+    case CMD_AUTO_MATCH:
+      // 安全等级(1) 起始页(2) 页数(2) 参数(2); 长度不符的包与真实模组一样以收包错误拒绝
+      if (param_len != 7) {
+        reply(delay, ACK_COMM_ERR, {STAGE_LEGALITY, 0x00, 0x00, 0x00, 0x00});
+        break;
+      }
+      auto_start_page_ = (p[1] << 8) | p[2];
+      auto_page_num_ = (p[3] << 8) | p[4];
+      auto_mode_ = AUTO_MATCH;
+      reply(delay, ACK_OK, {STAGE_LEGALITY, 0x00, 0x00, 0x00, 0x00});
+      break;
+
+    case CMD_INTO_SLEEP:
+      if (sleep_failures_ > 0) {
+        sleep_failures_--;
+        reply(delay, ACK_SLEEP_ERR);
+        break;
+      }
+      reply(delay, ACK_OK);
+      asleep_ = true;
+      sleep_start_us_ = now;
+      break;
+
+    case CMD_HANDSHAKE:
+    case CMD_RGB_CTRL:
+      reply(delay, ACK_OK);
+      break;
+
+    default:
+      reply(delay, ACK_COMM_ERR);
+      break;
+  }
+}
+
+// 自动模式: 模组空闲时按阶段推进, 每个阶段主动上报一条应答
+void ModuleSimulator::process_auto_mode() {
+  uint64_t now = SimClock::now_us();
+  uint32_t finger = finger_at(now);
+
+  if (auto_mode_ == AUTO_MATCH) {
+    if (finger == 0)
+      return;
+    uint32_t capture = delay_for(CMD_GET_IMAGE);
+    reply(capture, ACK_OK, {STAGE_GET_IMAGE, 0x00, 0x00, 0x00, 0x00});
+    uint32_t search = delay_for(CMD_GEN_CHAR) + delay_for(CMD_SEARCH);
+    uint16_t page;
+    if (library_contains(finger, auto_start_page_, auto_page_num_, &page)) {
+      search += search_page_cost_us_ * (page - auto_start_page_ + 1);
+      reply(search, ACK_OK,
+            {STAGE_SEARCH, static_cast<uint8_t>(page >> 8), static_cast<uint8_t>(page), MATCH_SCORE >> 8,
+             MATCH_SCORE & 0xFF});
+    } else {
+      reply(search + search_page_cost_us_ * auto_page_num_, ACK_NOT_SEARCHED, {STAGE_SEARCH, 0x00, 0x00, 0x00, 0x00});
+    }
+    // 单次验证后模组回到空闲, 由主机重新启动
+    auto_mode_ = AUTO_NONE;
+    return;
+  }
+
+  // 自动注册
+  if (now > auto_deadline_us_) {
+    reply(0, ACK_TIME_OUT, {auto_wait_lift_ ? STAGE_FINGER_LEAVE : STAGE_GET_IMAGE, auto_step_});
+    auto_mode_ = AUTO_NONE;
+    return;
+  }
+
+  if (auto_wait_lift_) {
+    if (finger != 0)
+      return;
+    reply(1000, ACK_OK, {STAGE_FINGER_LEAVE, auto_step_});
+    auto_wait_lift_ = false;
+    auto_step_++;
+    auto_deadline_us_ = now + AUTO_STEP_TIMEOUT_US;
+    return;
+  }
+
+  if (finger == 0)
+    return;
+  if (auto_finger_ == 0)
+    auto_finger_ = finger;
+  reply(delay_for(CMD_GET_IMAGE_ENROLL), ACK_OK, {STAGE_GET_IMAGE, auto_step_});
+  reply(delay_for(CMD_GEN_CHAR), finger == auto_finger_ ? ACK_OK : ACK_MERGE_ERR, {STAGE_GEN_CHAR, auto_step_});
+  if (auto_step_ < auto_count_) {
+    if (auto_param_ & AUTO_ENROLL_NO_LIFT) {
+      auto_step_++;
+    } else {
+      auto_wait_lift_ = true;
+    }
+    auto_deadline_us_ = now + AUTO_STEP_TIMEOUT_US;
+    return;
+  }
+
+  // 全部采集完成: 合并 -> 查重 (参数要求时) -> 存储
+  auto_mode_ = AUTO_NONE;
+  reply(delay_for(CMD_REG_MODEL), ACK_OK, {STAGE_MERGE, 0xF0});
+  if (auto_param_ & AUTO_ENROLL_NO_DUPLICATE) {
+    uint16_t page;
+    if (library_contains(auto_finger_, 0, capacity_, &page)) {
+      reply(delay_for(CMD_SEARCH), ACK_FP_DUPLICATION, {STAGE_DUPLICATE, 0xF1});
+      return;
+    }
+    reply(delay_for(CMD_SEARCH), ACK_OK, {STAGE_DUPLICATE, 0xF1});
+  }
+  if (auto_page_ >= capacity_) {
+    reply(delay_for(CMD_STORE_CHAR), ACK_ADDRESS_OVER, {STAGE_STORE, 0xF2});
+    return;
+  }
+  library_[auto_page_] = auto_finger_;
+  reply(delay_for(CMD_STORE_CHAR), ACK_OK, {STAGE_STORE, 0xF2});
+}
+
+}  // namespace zw101_sim
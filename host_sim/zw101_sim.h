@@ -0,0 +1,171 @@
+#pragma once
+
+#include "esphome/core/gpio.h"
+#include "virtual_uart.h"
+#include "zw101_protocol.h"
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <vector>
+
+namespace zw101_sim {
+
+// 模组 TOUCH_OUT 引脚: 手指按下时为高电平, 休眠中同样有效
+// 电平变化由仿真器每个步长更新, 边沿满足中断类型时直接调用中断处理函数
+class TouchOutPin : public esphome::InternalGPIOPin {
+ public:
+  void setup() override {}
+  bool digital_read() override { return level_; }
+  void update(bool level);
+
+ protected:
+  void attach_interrupt(void (*func)(void *), void *arg, esphome::gpio::InterruptType type) const override;
+
+  bool level_{false};
+  mutable void (*isr_)(void *){nullptr};
+  mutable void *isr_arg_{nullptr};
+  mutable esphome::gpio::InterruptType isr_type_{esphome::gpio::INTERRUPT_RISING_EDGE};
+};
+
+// ZW101 模组协议仿真器
+// - 指令集: 0x01/0x29 采图, 0x02 生成特征, 0x03 比对, 0x04 搜索, 0x05/0x06 合并/存储,
+//   0x07/0x08/0x09 读出/上传/下载模板 (数据包按 DATA_PACKET_SIZE 分包),
+//   0x0C/0x0D 删除/清空, 0x0E 写寄存器(波特率), 0x0F/0x1D/0x1F 读参数/个数/索引表, 0x15 设置地址,
+//   0x30-0x33 自动模式/休眠 (手指按下后经过上电时间才能响应), 0x35 握手, 0x3C 灯控, 0x9D 检查手指 (可关闭, 模拟不支持该指令的固件)
+// - TOUCH_OUT 引脚随按压脚本变化
+// - 每条指令的处理耗时可配置, 搜索按页号顺序比对, 耗时随比对到的页数线性增长, 找到即停
+// - 手指按压按脚本回放, 指纹库以 "页号 -> 手指编号" 表示
+class ModuleSimulator {
+ public:
+  // 确认码
+  static const uint8_t ACK_OK = 0x00;
+  static const uint8_t ACK_COMM_ERR = 0x01;
+  static const uint8_t ACK_NO_FINGER = 0x02;
+  static const uint8_t ACK_NOT_MATCH = 0x08;
+  static const uint8_t ACK_NOT_SEARCHED = 0x09;
+  static const uint8_t ACK_MERGE_ERR = 0x0A;
+  static const uint8_t ACK_ADDRESS_OVER = 0x0B;
+  static const uint8_t ACK_READ_TEMPLATE_ERR = 0x0C;
+  static const uint8_t ACK_UPLOAD_ERR = 0x0D;
+  static const uint8_t ACK_INVALID_IMAGE = 0x15;
+  static const uint8_t ACK_FP_DUPLICATION = 0x27;
+  static const uint8_t ACK_SLEEP_ERR = 0x12;
+
+  // 模板数据: 前4字节为手指编号 (大端), 其余字节由编号确定, 下载时逐字节校验
+  static const uint16_t TEMPLATE_SIZE = 512;
+  static const uint16_t DATA_PACKET_SIZE = 128;  // 与系统参数中的包大小 N=2 一致
+  static std::vector<uint8_t> make_template(uint32_t finger);
+
+  // tap 为虚拟串口上的模组接收端 (见 VirtualUART::add_module_tap), 多个模组共用一个串口时各用一个
+  explicit ModuleSimulator(VirtualUART *uart, size_t tap = 0);
+
+  // 配置
+  void set_command_delay_us(uint8_t cmd, uint32_t delay_us) { delays_us_[cmd] = delay_us; }
+  void set_search_page_cost_us(uint32_t cost_us) { search_page_cost_us_ = cost_us; }
+  void set_capacity(uint16_t capacity) { capacity_ = capacity; }
+  void set_check_finger_supported(bool supported) { check_finger_supported_ = supported; }
+  // 休眠: 手指按下后经过 wake_time 模组才能响应指令, 之前收到的指令被丢弃;
+  // 之后 count 次休眠指令返回休眠失败 (0x12)
+  void set_wake_time_us(uint32_t wake_time_us) { wake_time_us_ = wake_time_us; }
+  void set_sleep_failures(uint8_t count) { sleep_failures_ = count; }
+  bool asleep() const { return asleep_; }
+  uint16_t get_capacity() const { return capacity_; }
+  // 模组地址: 只响应发给该地址的帧, 应答使用该地址; 断电后保持
+  void set_address(uint32_t address) { address_ = address; }
+  uint32_t get_address() const { return address_; }
+
+  // 指纹库
+  void enroll(uint16_t page, uint32_t finger) { library_[page] = finger; }
+  const std::map<uint16_t, uint32_t> &library() const { return library_; }
+
+  // 按压脚本: [start_ms, end_ms) 期间手指 finger 按在传感器上
+  void add_touch(uint64_t start_ms, uint64_t end_ms, uint32_t finger);
+  uint32_t finger_at(uint64_t now_us) const;
+  TouchOutPin *touch_pin() { return &touch_pin_; }
+
+  // 每个仿真步调用: 接收指令, 发出到期的应答
+  void poll();
+
+  // 模组断电重启: 清空缓冲区和自动模式, 波特率恢复为上电值
+  // persistent 为 true 时写入的波特率保存在模组 flash 中, 重启后仍然有效
+  void set_baud_persistent(bool persistent) { baud_persistent_ = persistent; }
+  void power_cycle();
+
+  // 统计
+  uint32_t command_count(uint8_t cmd) const;
+  uint32_t total_commands() const { return total_commands_; }
+  uint64_t busy_us() const { return busy_us_; }
+  uint64_t asleep_us() const;  // 累计休眠时间, 含当前这次
+
+ protected:
+  struct Touch {
+    uint64_t start_us;
+    uint64_t end_us;
+    uint32_t finger;
+  };
+  struct ScheduledReply {
+    uint64_t ready_at_us;
+    std::vector<uint8_t> frame;
+    uint32_t baud_after{0};  // 非0时应答发出后切换到该波特率
+  };
+  enum AutoMode : uint8_t { AUTO_NONE, AUTO_ENROLL, AUTO_MATCH };
+
+  void handle_command(const uint8_t *frame, uint16_t length);
+  void reply(uint32_t delay_us, uint8_t code, const std::vector<uint8_t> &params = {});
+  void send_packet(uint32_t delay_us, uint8_t pid, const std::vector<uint8_t> &payload);
+  void receive_data_packet(const uint8_t *frame, uint16_t length);
+  uint32_t delay_for(uint8_t cmd) const;
+  void process_auto_mode();
+  bool library_contains(uint32_t finger, uint16_t start, uint16_t count, uint16_t *page) const;
+
+  VirtualUART *uart_;
+  size_t tap_;
+  uint32_t address_{esphome::zw101::BROADCAST_ADDRESS};
+  esphome::zw101::FrameParser parser_;
+  std::deque<ScheduledReply> replies_;
+  uint64_t busy_until_us_{0};  // 模组串行处理指令, 忙时后到的指令顺延
+
+  std::map<uint8_t, uint32_t> delays_us_;
+  uint32_t search_page_cost_us_{200};
+  uint16_t capacity_{50};
+  std::map<uint16_t, uint32_t> library_;
+  std::vector<Touch> touches_;
+  TouchOutPin touch_pin_;
+
+  // 图像缓冲区与特征缓冲区 (0 表示空)
+  uint32_t image_{0};
+  uint32_t char_buffers_[6]{};
+
+  // 下载中的特征缓冲区 (0 表示没有下载) 及已收到的数据
+  uint8_t download_buffer_{0};
+  std::vector<uint8_t> download_data_;
+
+  bool asleep_{false};
+  uint64_t sleep_start_us_{0};
+  uint64_t wake_at_us_{0};  // 非0时模组正在上电
+  uint32_t wake_time_us_{50000};
+  uint8_t sleep_failures_{0};
+  uint64_t asleep_total_us_{0};
+  bool check_finger_supported_{true};
+  bool baud_persistent_{true};
+  uint32_t stored_baud_rate_{57600};  // 上电时使用的波特率
+
+  // 自动模式
+  AutoMode auto_mode_{AUTO_NONE};
+  uint8_t auto_step_{0};   // 自动注册: 当前第几次采集 (从1开始)
+  uint8_t auto_count_{0};  // 自动注册: 需要采集的次数
+  uint16_t auto_page_{0};
+  uint16_t auto_param_{0};  // 自动注册参数: bit4=1 查重, bit5=1 采集之间不要求手指离开
+  uint32_t auto_finger_{0};
+  uint64_t auto_deadline_us_{0};
+  uint16_t auto_start_page_{0};
+  uint16_t auto_page_num_{0};
+  bool auto_wait_lift_{false};
+
+  std::map<uint8_t, uint32_t> command_counts_;
+  uint32_t total_commands_{0};
+  uint64_t busy_us_{0};
+};
+
+}  // namespace zw101_sim